@@ -6,6 +6,8 @@
 
 #include "aircraft.h"
 
+#include "loader.h"
+
 #include <math.h>
 #include <json-glib/json-glib.h>
 
@@ -108,6 +110,7 @@ static gboolean vfr_aircraft_load()
     return TRUE;
 }
 
+// Called once, from vfr_loader_start() or when aircraft are first needed
 gboolean vfr_aircraft_init()
 {
     aircraft_list = g_malloc0(sizeof(VFRAircraftList));
@@ -118,6 +121,8 @@ gboolean vfr_aircraft_init()
 
 guint vfr_aircraft_get_count()
 {
+    vfr_loader_wait(VFR_LOADER_AIRCRAFT);
+
     if (aircraft_list)
         return aircraft_list->list->len;
 
@@ -126,6 +131,8 @@ guint vfr_aircraft_get_count()
 
 VFRAircraft *vfr_aircraft_get(guint index)
 {
+    vfr_loader_wait(VFR_LOADER_AIRCRAFT);
+
     if (aircraft_list && aircraft_list->list->len > index)
         return aircraft_list->list->pdata[index];
 
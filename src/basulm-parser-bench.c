@@ -0,0 +1,185 @@
+/*
+ * (C) Copyright 2019, Arnaud Ferraris <arnaud.ferraris@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ */
+
+/*
+ * Compare the streaming parser of the BASULM terrains list with loading it
+ * as a json-glib DOM (as was done before), on a synthetic list. Built with
+ * `make basulm-parser-bench`:
+ *
+ *   basulm-parser-bench [ENTRIES] [ROUNDS]
+ *
+ * Each method runs in its own process, so that its peak memory usage (the
+ * growth of the maximum resident set size) can be measured separately.
+ */
+
+#include "basulm-parser.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <glib/gstdio.h>
+#include <json-glib/json-glib.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#define BENCH_CHUNK_SIZE (16 * 1024)
+
+typedef guint (*bench_parse_cb)(const gchar *filename);
+
+static gchar *bench_write_list(guint entries)
+{
+    GString *list = g_string_new("{\"status\":\"ok\",\"liste\":[");
+    gchar *filename = NULL;
+    int fd;
+
+    for (guint i = 0; i < entries; i++) {
+        g_string_append_printf(list, "%s{\"code_terrain\":\"LF%05u\","
+                               "\"toponyme\":\"Terrain %u de l'essai\",\"type\":\"ULM\","
+                               "\"altitude\":%u,\"position\":{\"lat\":%u.%04u,\"lon\":%u.%04u},"
+                               "\"actif\":true}",
+                               i ? "," : "", i, i, i % 3000, 42 + i % 9, i % 10000,
+                               i % 8, (i * 7) % 10000);
+    }
+    g_string_append(list, "]}");
+
+    fd = g_file_open_tmp("librevfr-basulm-XXXXXX", &filename, NULL);
+    if (fd < 0 || write(fd, list->str, list->len) != (gssize)list->len) {
+        g_free(filename);
+        filename = NULL;
+    }
+    if (fd >= 0)
+        close(fd);
+    g_string_free(list, TRUE);
+
+    return filename;
+}
+
+// Read by chunks, as curl hands the response over
+static guint bench_parse_stream(const gchar *filename)
+{
+    VFRTerrainArena *arena = vfr_terrain_arena_new();
+    VFRBasulmParser *parser = vfr_basulm_parser_new(arena);
+    gchar *buffer = g_malloc(BENCH_CHUNK_SIZE);
+    FILE *file = fopen(filename, "rb");
+    guint count = 0;
+    size_t len;
+
+    while (file && (len = fread(buffer, 1, BENCH_CHUNK_SIZE, file)) > 0) {
+        if (!vfr_basulm_parser_feed(parser, buffer, len))
+            break;
+    }
+
+    if (vfr_basulm_parser_end(parser))
+        count = vfr_terrain_arena_get_terrains(arena)->len;
+
+    if (file)
+        fclose(file);
+    g_free(buffer);
+    vfr_basulm_parser_free(parser);
+    vfr_terrain_arena_free(arena);
+
+    return count;
+}
+
+static guint bench_parse_dom(const gchar *filename)
+{
+    GPtrArray *terrains = g_ptr_array_new_with_free_func((GDestroyNotify)vfr_terrain_free);
+    JsonParser *parser = json_parser_new();
+    JsonObject *object;
+    JsonArray *array;
+    guint count = 0;
+
+    if (json_parser_load_from_file(parser, filename, NULL)) {
+        object = json_node_get_object(json_parser_get_root(parser));
+        array = json_object_get_array_member(object, "liste");
+
+        for (guint i = 0; i < json_array_get_length(array); i++) {
+            JsonObject *entry = json_array_get_object_element(array, i);
+
+            g_ptr_array_add(terrains,
+                            vfr_terrain_new(json_object_get_string_member(entry, "toponyme"),
+                                            json_object_get_string_member(entry, "code_terrain"),
+                                            FALSE));
+        }
+        count = terrains->len;
+    }
+
+    g_object_unref(parser);
+    g_ptr_array_free(terrains, TRUE);
+
+    return count;
+}
+
+static glong bench_get_max_rss(void)
+{
+    struct rusage usage;
+
+    getrusage(RUSAGE_SELF, &usage);
+
+    return usage.ru_maxrss;
+}
+
+static gboolean bench_run(const gchar *method, bench_parse_cb parse, const gchar *filename,
+                          guint entries, guint rounds)
+{
+    int status = 1;
+    pid_t pid;
+
+    fflush(stdout);
+    pid = fork();
+    if (pid == 0) {
+        glong rss = bench_get_max_rss();
+        gint64 start = g_get_monotonic_time();
+        GStatBuf st;
+        gdouble elapsed;
+        guint count = 0;
+
+        for (guint i = 0; i < rounds; i++)
+            count = parse(filename);
+
+        elapsed = (g_get_monotonic_time() - start) / (gdouble)G_USEC_PER_SEC;
+        if (count != entries) {
+            printf("%s: %u terrains parsed out of %u\n", method, count, entries);
+            _exit(1);
+        }
+
+        g_stat(filename, &st);
+        printf("%-6s %8.2f ms per list %8.1f MiB/s %8ld KiB peak\n", method,
+               elapsed * 1000 / rounds, st.st_size * (gdouble)rounds / elapsed / (1024 * 1024),
+               bench_get_max_rss() - rss);
+        fflush(stdout);
+        _exit(0);
+    }
+
+    if (pid < 0 || waitpid(pid, &status, 0) < 0)
+        return FALSE;
+
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+int main(int argc, char *argv[])
+{
+    guint entries = argc > 1 ? (guint)atoi(argv[1]) : 20000;
+    guint rounds = MAX(argc > 2 ? (guint)atoi(argv[2]) : 10, 1);
+    gchar *filename = bench_write_list(entries);
+    gboolean result;
+
+    if (!filename) {
+        printf("unable to write the synthetic list\n");
+        return 1;
+    }
+
+    printf("%u entries, %u rounds\n", entries, rounds);
+    result = bench_run("stream", bench_parse_stream, filename, entries, rounds);
+    result = bench_run("dom", bench_parse_dom, filename, entries, rounds) && result;
+
+    g_remove(filename);
+    g_free(filename);
+
+    return result ? 0 : 1;
+}
@@ -0,0 +1,114 @@
+/*
+ * (C) Copyright 2019, Arnaud Ferraris <arnaud.ferraris@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ */
+
+#include "basulm-parser.h"
+
+#include "json-reader.h"
+
+/*
+ * The list is a JSON object holding a "status" string and a "liste" array
+ * of objects describing each terrain. It is parsed as it is received, and
+ * only the current terrain's name and code are kept along the way.
+ */
+struct _VFRBasulmParser {
+    VFRJsonReader *reader;
+    VFRTerrainArena *arena;
+    GString *name;
+    GString *code;
+    gboolean in_list;
+    gboolean status_ok;
+    gboolean failed;
+};
+
+static void basulm_json_cb(VFRJsonEvent event, guint depth, const gchar *key,
+                           const gchar *value, gpointer data)
+{
+    VFRBasulmParser *parser = data;
+
+    switch (event) {
+    case VFR_JSON_ARRAY_START:
+    case VFR_JSON_ARRAY_END:
+        if (depth == 1 && (event == VFR_JSON_ARRAY_END || g_strcmp0(key, "liste") == 0))
+            parser->in_list = event == VFR_JSON_ARRAY_START;
+        break;
+    case VFR_JSON_OBJECT_START:
+        // Objects nested within a terrain's must not discard its fields
+        if (parser->in_list && depth == 2) {
+            g_string_truncate(parser->name, 0);
+            g_string_truncate(parser->code, 0);
+        }
+        break;
+    case VFR_JSON_OBJECT_END:
+        if (parser->in_list && depth == 2 && parser->name->len > 0 && parser->code->len > 0) {
+            vfr_terrain_arena_add(parser->arena, parser->name->str, parser->code->str, FALSE);
+        }
+        break;
+    case VFR_JSON_STRING:
+        if (depth == 1 && g_strcmp0(key, "status") == 0)
+            parser->status_ok = g_str_equal(value, "ok");
+        else if (parser->in_list && depth == 3 && g_strcmp0(key, "toponyme") == 0)
+            g_string_assign(parser->name, value);
+        else if (parser->in_list && depth == 3 && g_strcmp0(key, "code_terrain") == 0)
+            g_string_assign(parser->code, value);
+        break;
+    default:
+        break;
+    }
+}
+
+VFRBasulmParser *vfr_basulm_parser_new(VFRTerrainArena *arena)
+{
+    VFRBasulmParser *parser = g_malloc0(sizeof(VFRBasulmParser));
+
+    parser->reader = vfr_json_reader_new(basulm_json_cb, parser);
+    parser->arena = arena;
+    parser->name = g_string_new(NULL);
+    parser->code = g_string_new(NULL);
+
+    return parser;
+}
+
+void vfr_basulm_parser_free(VFRBasulmParser *parser)
+{
+    if (!parser)
+        return;
+
+    vfr_json_reader_free(parser->reader);
+    g_string_free(parser->name, TRUE);
+    g_string_free(parser->code, TRUE);
+    g_free(parser);
+}
+
+// Start over with an empty list, e.g. when the download is retried
+void vfr_basulm_parser_reset(VFRBasulmParser *parser)
+{
+    if (!parser)
+        return;
+
+    vfr_json_reader_free(parser->reader);
+    parser->reader = vfr_json_reader_new(basulm_json_cb, parser);
+    vfr_terrain_arena_clear(parser->arena);
+    g_string_truncate(parser->name, 0);
+    g_string_truncate(parser->code, 0);
+    parser->in_list = FALSE;
+    parser->status_ok = FALSE;
+    parser->failed = FALSE;
+}
+
+// FALSE once the data received isn't valid JSON
+gboolean vfr_basulm_parser_feed(VFRBasulmParser *parser, const gchar *data, gsize len)
+{
+    if (!parser->failed && !vfr_json_reader_feed(parser->reader, data, len))
+        parser->failed = TRUE;
+
+    return !parser->failed;
+}
+
+// Whether a complete list with an "ok" status was received
+gboolean vfr_basulm_parser_end(VFRBasulmParser *parser)
+{
+    return !parser->failed && parser->status_ok && vfr_json_reader_end(parser->reader);
+}
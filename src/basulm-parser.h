@@ -0,0 +1,23 @@
+/*
+ * (C) Copyright 2019, Arnaud Ferraris <arnaud.ferraris@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ */
+
+#ifndef _VFR_BASULM_PARSER_H
+#define _VFR_BASULM_PARSER_H
+
+#include <glib.h>
+
+#include "terrain-arena.h"
+
+typedef struct _VFRBasulmParser VFRBasulmParser;
+
+VFRBasulmParser *vfr_basulm_parser_new(VFRTerrainArena *arena);
+void vfr_basulm_parser_free(VFRBasulmParser *parser);
+void vfr_basulm_parser_reset(VFRBasulmParser *parser);
+
+gboolean vfr_basulm_parser_feed(VFRBasulmParser *parser, const gchar *data, gsize len);
+gboolean vfr_basulm_parser_end(VFRBasulmParser *parser);
+
+#endif /* _VFR_BASULM_PARSER_H */
@@ -0,0 +1,243 @@
+/*
+ * (C) Copyright 2019, Arnaud Ferraris <arnaud.ferraris@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ */
+
+#include "chart-cache.h"
+
+#include "user-state.h"
+
+#include <sys/stat.h>
+
+#include <glib/gstdio.h>
+
+/*
+ * Charts are kept on disk within a budget: when it is exceeded, the charts
+ * opened least recently are evicted, and fetched again when next opened.
+ * This records which charts were evicted in $XDG_DATA_HOME/librevfr/usage;
+ * lines are "<provider>/<ICAO>", the time of the last opening and whether
+ * the chart was evicted, separated by tabs. The time of the last opening is
+ * now kept in the user state journal, and only read here from older files.
+ */
+
+typedef struct {
+    gint64 last_open;
+    gboolean evicted;
+} VFRChartUsage;
+
+typedef struct {
+    GMutex lock;
+    GHashTable *charts;
+    GString *filename;
+    gboolean dirty;
+} VFRChartCache;
+
+static VFRChartCache *chart_cache_get(void)
+{
+    static VFRChartCache *cache = NULL;
+    gchar *contents = NULL;
+    gchar **lines;
+
+    if (g_once_init_enter(&cache)) {
+        VFRChartCache *self = g_malloc0(sizeof(VFRChartCache));
+
+        g_mutex_init(&self->lock);
+        self->charts = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+        self->filename = g_string_new(g_get_user_data_dir());
+        g_string_append(self->filename, "/librevfr/usage");
+
+        if (g_file_get_contents(self->filename->str, &contents, NULL, NULL)) {
+            lines = g_strsplit(contents, "\n", -1);
+            for (guint i = 0; lines[i]; i++) {
+                gchar **fields = g_strsplit(lines[i], "\t", 3);
+                VFRChartUsage *usage;
+
+                if (g_strv_length(fields) == 3) {
+                    usage = g_malloc0(sizeof(VFRChartUsage));
+                    usage->last_open = g_ascii_strtoll(fields[1], NULL, 10);
+                    usage->evicted = g_str_equal(fields[2], "1");
+                    g_hash_table_insert(self->charts, g_strdup(fields[0]), usage);
+                }
+                g_strfreev(fields);
+            }
+            g_strfreev(lines);
+            g_free(contents);
+        }
+
+        g_once_init_leave(&cache, self);
+    }
+
+    return cache;
+}
+
+// Must be called with the lock held
+static VFRChartUsage *chart_cache_lookup(VFRChartCache *self, const gchar *provider,
+                                         const gchar *icao, gboolean create)
+{
+    gchar *key = g_strdup_printf("%s/%s", provider, icao);
+    VFRChartUsage *usage = g_hash_table_lookup(self->charts, key);
+
+    if (!usage && create) {
+        usage = g_malloc0(sizeof(VFRChartUsage));
+        g_hash_table_insert(self->charts, key, usage);
+    } else {
+        g_free(key);
+    }
+
+    return usage;
+}
+
+goffset vfr_chart_cache_get_budget(void)
+{
+    const gchar *env = g_getenv("LIBREVFR_DISK_BUDGET_MB");
+
+    // A budget of 0 disables eviction
+    if (env)
+        return (goffset)g_ascii_strtoull(env, NULL, 10) * 1024 * 1024;
+
+    return VFR_CHART_CACHE_DEFAULT_BUDGET;
+}
+
+static goffset chart_cache_dir_usage(const gchar *path, GHashTable *inodes)
+{
+    GString *child = g_string_new(NULL);
+    const gchar *name;
+    goffset usage = 0;
+    GStatBuf st;
+    gint64 *inode;
+    GDir *dir;
+
+    dir = g_dir_open(path, 0, NULL);
+    while (dir && (name = g_dir_read_name(dir)) != NULL) {
+        g_string_printf(child, "%s/%s", path, name);
+        if (g_lstat(child->str, &st) < 0 || S_ISLNK(st.st_mode))
+            continue;
+
+        if (S_ISDIR(st.st_mode)) {
+            usage += chart_cache_dir_usage(child->str, inodes);
+        } else if (st.st_nlink <= 1) {
+            usage += st.st_size;
+        } else {
+            inode = g_new(gint64, 1);
+            *inode = st.st_ino;
+
+            // Files linked from the chart store are only counted once
+            if (g_hash_table_add(inodes, inode))
+                usage += st.st_size;
+        }
+    }
+
+    if (dir)
+        g_dir_close(dir);
+    g_string_free(child, TRUE);
+
+    return usage;
+}
+
+// Disk space used by all of LibreVFR's data
+goffset vfr_chart_cache_get_usage(void)
+{
+    GHashTable *inodes = g_hash_table_new_full(g_int64_hash, g_int64_equal, g_free, NULL);
+    gchar *root = g_build_filename(g_get_user_data_dir(), "librevfr", NULL);
+    goffset usage = chart_cache_dir_usage(root, inodes);
+
+    g_hash_table_destroy(inodes);
+    g_free(root);
+
+    return usage;
+}
+
+// Record that a chart was opened: it's now the last one to be evicted
+void vfr_chart_cache_touch(const gchar *provider, const gchar *icao)
+{
+    VFRChartCache *self = chart_cache_get();
+    VFRChartUsage *usage;
+
+    vfr_user_state_touch(provider, icao);
+
+    // The usage file is only rewritten if the chart was evicted
+    g_mutex_lock(&self->lock);
+    usage = chart_cache_lookup(self, provider, icao, FALSE);
+    if (usage && usage->evicted) {
+        usage->evicted = FALSE;
+        self->dirty = TRUE;
+    }
+    g_mutex_unlock(&self->lock);
+
+    vfr_chart_cache_save();
+}
+
+// Time of the last opening, 0 if the chart was never opened
+gint64 vfr_chart_cache_get_last_open(const gchar *provider, const gchar *icao)
+{
+    VFRChartCache *self = chart_cache_get();
+    VFRChartUsage *usage;
+    gint64 result = vfr_user_state_get_last_open(provider, icao);
+
+    g_mutex_lock(&self->lock);
+    usage = chart_cache_lookup(self, provider, icao, FALSE);
+    if (usage)
+        result = MAX(result, usage->last_open);
+    g_mutex_unlock(&self->lock);
+
+    return result;
+}
+
+void vfr_chart_cache_set_evicted(const gchar *provider, const gchar *icao)
+{
+    VFRChartCache *self = chart_cache_get();
+
+    g_mutex_lock(&self->lock);
+    chart_cache_lookup(self, provider, icao, TRUE)->evicted = TRUE;
+    self->dirty = TRUE;
+    g_mutex_unlock(&self->lock);
+}
+
+// Evicted charts are only downloaded again when opened
+gboolean vfr_chart_cache_is_evicted(const gchar *provider, const gchar *icao)
+{
+    VFRChartCache *self = chart_cache_get();
+    VFRChartUsage *usage;
+    gboolean result = FALSE;
+
+    g_mutex_lock(&self->lock);
+    usage = chart_cache_lookup(self, provider, icao, FALSE);
+    if (usage)
+        result = usage->evicted;
+    g_mutex_unlock(&self->lock);
+
+    return result;
+}
+
+gboolean vfr_chart_cache_save(void)
+{
+    VFRChartCache *self = chart_cache_get();
+    GString *contents;
+    GHashTableIter iter;
+    gpointer key, value;
+    gboolean result;
+
+    g_mutex_lock(&self->lock);
+    if (!self->dirty) {
+        g_mutex_unlock(&self->lock);
+        return TRUE;
+    }
+
+    contents = g_string_new(NULL);
+    g_hash_table_iter_init(&iter, self->charts);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        VFRChartUsage *usage = value;
+
+        g_string_append_printf(contents, "%s\t%" G_GINT64_FORMAT "\t%d\n", (gchar *)key,
+                               usage->last_open, usage->evicted ? 1 : 0);
+    }
+
+    result = g_file_set_contents(self->filename->str, contents->str, contents->len, NULL);
+    if (result)
+        self->dirty = FALSE;
+    g_mutex_unlock(&self->lock);
+    g_string_free(contents, TRUE);
+
+    return result;
+}
@@ -0,0 +1,25 @@
+/*
+ * (C) Copyright 2019, Arnaud Ferraris <arnaud.ferraris@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ */
+
+#ifndef _VFR_CHART_CACHE_H
+#define _VFR_CHART_CACHE_H
+
+#include <glib.h>
+
+#define VFR_CHART_CACHE_DEFAULT_BUDGET (1024 * 1024 * 1024)
+
+goffset vfr_chart_cache_get_budget(void);
+goffset vfr_chart_cache_get_usage(void);
+
+void vfr_chart_cache_touch(const gchar *provider, const gchar *icao);
+gint64 vfr_chart_cache_get_last_open(const gchar *provider, const gchar *icao);
+
+void vfr_chart_cache_set_evicted(const gchar *provider, const gchar *icao);
+gboolean vfr_chart_cache_is_evicted(const gchar *provider, const gchar *icao);
+
+gboolean vfr_chart_cache_save(void);
+
+#endif /* _VFR_CHART_CACHE_H */
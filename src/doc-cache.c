@@ -0,0 +1,258 @@
+/*
+ * (C) Copyright 2019, Arnaud Ferraris <arnaud.ferraris@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ */
+
+#include "doc-cache.h"
+
+#include <glib/gstdio.h>
+
+/*
+ * Opened documents are kept in a LRU list, bounded by a memory budget.
+ * The cost of a document is estimated from the size of its file, which is
+ * cheap to get and good enough to compare charts with each other.
+ */
+
+typedef struct {
+    vfr_doc_cache_cb callback;
+    gpointer data;
+} VFRDocRequest;
+
+typedef struct {
+    VFRDocCache *cache;
+    GString *key;
+    gchar *filename;
+    EvDocument *document;
+    EvJob *job;
+    goffset size;
+    GList *requests;
+} VFRDocEntry;
+
+struct _VFRDocCache {
+    GHashTable *entries;
+    GQueue *lru;
+    goffset budget;
+    goffset used;
+};
+
+static goffset doc_cache_default_budget(void)
+{
+    const gchar *env = g_getenv("LIBREVFR_DOC_CACHE_MB");
+    guint64 value;
+
+    if (env) {
+        value = g_ascii_strtoull(env, NULL, 10);
+        if (value > 0)
+            return (goffset)value * 1024 * 1024;
+    }
+
+    return VFR_DOC_CACHE_DEFAULT_BUDGET;
+}
+
+static void doc_cache_job_finished_cb(EvJob *job, VFRDocEntry *entry);
+
+static void doc_cache_entry_cancel(VFRDocEntry *entry)
+{
+    if (entry->job) {
+        g_signal_handlers_disconnect_by_func(entry->job, doc_cache_job_finished_cb, entry);
+        ev_job_cancel(entry->job);
+        g_clear_object(&entry->job);
+    }
+}
+
+// Start loading the document, its requests are called back once done
+static void doc_cache_entry_load(VFRDocEntry *entry)
+{
+    GStatBuf st;
+    gchar *uri;
+
+    doc_cache_entry_cancel(entry);
+
+    entry->size = g_stat(entry->filename, &st) == 0 ? st.st_size : 0;
+
+    uri = g_filename_to_uri(entry->filename, NULL, NULL);
+    entry->job = ev_job_load_new(uri);
+    g_free(uri);
+
+    g_signal_connect(entry->job, "finished", G_CALLBACK(doc_cache_job_finished_cb), entry);
+    ev_job_scheduler_push_job(entry->job, EV_JOB_PRIORITY_NONE);
+}
+
+static void doc_cache_entry_free(VFRDocEntry *entry)
+{
+    doc_cache_entry_cancel(entry);
+
+    if (entry->document)
+        g_object_unref(entry->document);
+
+    g_list_free_full(entry->requests, g_free);
+    g_string_free(entry->key, TRUE);
+    g_free(entry->filename);
+    g_free(entry);
+}
+
+static void doc_cache_trim(VFRDocCache *self)
+{
+    VFRDocEntry *entry;
+
+    // Never evict the most recently used document, even if it's too big
+    while (self->used > self->budget && g_queue_get_length(self->lru) > 1) {
+        entry = g_queue_pop_tail(self->lru);
+        self->used -= entry->size;
+        g_hash_table_remove(self->entries, entry->key->str);
+    }
+}
+
+static void doc_cache_job_finished_cb(EvJob *job, VFRDocEntry *entry)
+{
+    VFRDocCache *self = entry->cache;
+    GList *requests = entry->requests;
+    gchar *key = g_strdup(entry->key->str);
+    EvDocument *document = NULL;
+    GError *error = NULL;
+
+    entry->requests = NULL;
+    g_signal_handlers_disconnect_by_func(job, doc_cache_job_finished_cb, entry);
+    entry->job = NULL;
+
+    if (ev_job_is_failed(job)) {
+        error = g_error_copy(job->error);
+        g_hash_table_remove(self->entries, key);
+    } else {
+        document = g_object_ref(job->document);
+        entry->document = g_object_ref(document);
+
+        g_queue_push_head(self->lru, entry);
+        self->used += entry->size;
+        doc_cache_trim(self);
+    }
+
+    for (GList *l = requests; l != NULL; l = l->next) {
+        VFRDocRequest *request = l->data;
+
+        request->callback(key, document, error, request->data);
+    }
+
+    g_list_free_full(requests, g_free);
+    g_object_unref(job);
+    if (document)
+        g_object_unref(document);
+    if (error)
+        g_error_free(error);
+    g_free(key);
+}
+
+VFRDocCache *vfr_doc_cache_new(goffset budget)
+{
+    VFRDocCache *self = g_malloc0(sizeof(VFRDocCache));
+
+    self->entries = g_hash_table_new_full(g_str_hash, g_str_equal, NULL,
+                                          (GDestroyNotify)doc_cache_entry_free);
+    self->lru = g_queue_new();
+    self->budget = budget > 0 ? budget : doc_cache_default_budget();
+
+    return self;
+}
+
+void vfr_doc_cache_free(VFRDocCache *self)
+{
+    if (!self)
+        return;
+
+    g_queue_free(self->lru);
+    g_hash_table_destroy(self->entries);
+    g_free(self);
+}
+
+/*
+ * Forget the documents whose key starts with `prefix` (all of them if NULL),
+ * e.g. after their files were updated. Documents still loading are loaded
+ * again from the new files, their callbacks are only called once done.
+ */
+void vfr_doc_cache_invalidate(VFRDocCache *self, const gchar *prefix)
+{
+    GHashTableIter iter;
+    VFRDocEntry *entry;
+
+    if (!self)
+        return;
+
+    g_hash_table_iter_init(&iter, self->entries);
+    while (g_hash_table_iter_next(&iter, NULL, (gpointer *)&entry)) {
+        if (prefix && !g_str_has_prefix(entry->key->str, prefix))
+            continue;
+
+        if (entry->job) {
+            doc_cache_entry_load(entry);
+        } else {
+            g_queue_remove(self->lru, entry);
+            self->used -= entry->size;
+            g_hash_table_iter_remove(&iter);
+        }
+    }
+}
+
+void vfr_doc_cache_set_budget(VFRDocCache *self, goffset budget)
+{
+    if (!self || budget <= 0)
+        return;
+
+    self->budget = budget;
+    doc_cache_trim(self);
+}
+
+// Whether the document is loaded and can be returned immediately
+gboolean vfr_doc_cache_contains(VFRDocCache *self, const gchar *key)
+{
+    VFRDocEntry *entry;
+
+    if (!self || !key)
+        return FALSE;
+
+    entry = g_hash_table_lookup(self->entries, key);
+
+    return entry && entry->document;
+}
+
+/*
+ * Documents are loaded by the Evince job scheduler, outside of the main
+ * thread. The callback is always called from the main loop, immediately
+ * when the document is already cached.
+ */
+void vfr_doc_cache_load(VFRDocCache *self, const gchar *key, const gchar *filename,
+                        vfr_doc_cache_cb callback, gpointer data)
+{
+    VFRDocEntry *entry;
+    VFRDocRequest *request;
+
+    if (!self || !key || !filename || !callback)
+        return;
+
+    entry = g_hash_table_lookup(self->entries, key);
+    if (entry && entry->document) {
+        g_queue_remove(self->lru, entry);
+        g_queue_push_head(self->lru, entry);
+        callback(key, entry->document, NULL, data);
+        return;
+    }
+
+    request = g_malloc0(sizeof(VFRDocRequest));
+    request->callback = callback;
+    request->data = data;
+
+    // Already loading, only wait for the running job
+    if (entry) {
+        entry->requests = g_list_append(entry->requests, request);
+        return;
+    }
+
+    entry = g_malloc0(sizeof(VFRDocEntry));
+    entry->cache = self;
+    entry->key = g_string_new(key);
+    entry->filename = g_strdup(filename);
+    entry->requests = g_list_append(NULL, request);
+
+    g_hash_table_insert(self->entries, entry->key->str, entry);
+    doc_cache_entry_load(entry);
+}
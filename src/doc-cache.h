@@ -0,0 +1,29 @@
+/*
+ * (C) Copyright 2019, Arnaud Ferraris <arnaud.ferraris@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ */
+
+#ifndef _VFR_DOC_CACHE_H
+#define _VFR_DOC_CACHE_H
+
+#include <evince-document.h>
+#include <evince-view.h>
+
+#define VFR_DOC_CACHE_DEFAULT_BUDGET (64 * 1024 * 1024)
+
+typedef struct _VFRDocCache VFRDocCache;
+
+typedef void (*vfr_doc_cache_cb)(const gchar *key, EvDocument *document, const GError *error,
+                                 gpointer data);
+
+VFRDocCache *vfr_doc_cache_new(goffset budget);
+void vfr_doc_cache_free(VFRDocCache *self);
+
+void vfr_doc_cache_invalidate(VFRDocCache *self, const gchar *prefix);
+void vfr_doc_cache_set_budget(VFRDocCache *self, goffset budget);
+gboolean vfr_doc_cache_contains(VFRDocCache *self, const gchar *key);
+void vfr_doc_cache_load(VFRDocCache *self, const gchar *key, const gchar *filename,
+                        vfr_doc_cache_cb callback, gpointer data);
+
+#endif /* _VFR_DOC_CACHE_H */
@@ -6,79 +6,265 @@
 
 #include "docs.h"
 
+#include "chart-cache.h"
+#include "doc-cache.h"
+#include "loader.h"
+#include "preview.h"
 #include "provider.h"
+#include "search.h"
+#include "terrain-list.h"
 #include "utils.h"
 
+#define SEARCH_MAX_RESULTS 50
+#define DATA_PAGE_SIZE 50
+
 struct _VFRDocsPage {
     GtkWidget *parent_stack;
     GtkWidget *menu_stack;
 
     GtkWidget *label;
+    GtkWidget *search_entry;
+    GtkWidget *search_scroll;
+    GtkWidget *search_box;
     GtkWidget *list_box;
     GtkWidget *data_box;
     GtkWidget *data_label;
     GtkWidget *pdf_view;
+    GtkWidget *pdf_preview;
     EvDocumentModel *pdf_model;
-    EvDocument *pdf;
+    VFRDocCache *pdf_cache;
+    GString *pdf_key;
 
     VFRProvider *current_provider;
     GPtrArray *providers;
+    GPtrArray *provider_rows;
+    GCancellable *cancellable;
+
+    VFRSearch *search;
+    GArray *search_results;
 };
 
-static void data_selected_cb(GtkListBox *list_box, GtkListBoxRow *row, VFRDocsPage *self)
+static void docs_chart_loaded_cb(const gchar *key, EvDocument *document, const GError *error,
+                                 gpointer data)
+{
+    VFRDocsPage *self = data;
+
+    // Another chart was requested in the meantime
+    if (!g_str_equal(key, self->pdf_key->str))
+        return;
+
+    if (error) {
+        printf("Unable to open %s: %s\n", key, error->message);
+        return;
+    }
+
+    ev_document_model_set_document(self->pdf_model, document);
+    gtk_stack_set_visible_child_name(GTK_STACK(self->parent_stack), "pdf");
+}
+
+static void docs_chart_fetched_cb(VFRProvider *provider, const gchar *icao, gboolean success,
+                                  gpointer data)
+{
+    VFRDocsPage *self = data;
+    gchar *key = g_strdup_printf("%s/%s", vfr_provider_get_id(provider), icao);
+    gboolean current = g_str_equal(key, self->pdf_key->str);
+    char file[1024];
+
+    g_free(key);
+
+    // Another chart was requested in the meantime
+    if (!current)
+        return;
+
+    if (!success) {
+        printf("Unable to download %s chart for %s\n", vfr_provider_get_id(provider), icao);
+        return;
+    }
+
+    sprintf(file, "%s/librevfr/%s/files/%s.pdf", g_get_user_data_dir(),
+                                           vfr_provider_get_id(provider),
+                                           icao);
+    vfr_doc_cache_load(self->pdf_cache, self->pdf_key->str, file, docs_chart_loaded_cb, self);
+}
+
+static void docs_open_chart(VFRDocsPage *self, VFRProvider *provider, const gchar *icao)
 {
-    const char *selected = hdy_action_row_get_subtitle(HDY_ACTION_ROW(row));
-    GError *err = NULL;
     char file[1024];
-    const char *uri;
 
     sprintf(file, "%s/librevfr/%s/files/%s.pdf", g_get_user_data_dir(),
-                                           vfr_provider_get_id(self->current_provider),
-                                           selected);
-    uri = g_filename_to_uri(file, NULL, NULL);
+                                           vfr_provider_get_id(provider),
+                                           icao);
+
+    g_string_printf(self->pdf_key, "%s/%s", vfr_provider_get_id(provider), icao);
+    vfr_chart_cache_touch(vfr_provider_get_id(provider), icao);
+
+    // Show the pre-rendered first page while the document is loading
+    if (!vfr_doc_cache_contains(self->pdf_cache, self->pdf_key->str)) {
+        GString *preview = vfr_preview_get_filename(provider, icao, VFR_PREVIEW_PAGE);
 
-    self->pdf = ev_document_factory_get_document(uri, &err);
-    if (err) {
-        printf("Unable to open %s: %s\n", file, err->message);
+        if (g_file_test(preview->str, G_FILE_TEST_EXISTS)) {
+            gtk_image_set_from_file(GTK_IMAGE(self->pdf_preview), preview->str);
+            gtk_stack_set_visible_child_name(GTK_STACK(self->parent_stack), "preview");
+        }
+        g_string_free(preview, TRUE);
+    }
+
+    // The chart may have been evicted to save space, download it again
+    if (!vfr_doc_cache_contains(self->pdf_cache, self->pdf_key->str) &&
+        !g_file_test(file, G_FILE_TEST_EXISTS)) {
+        vfr_provider_fetch_chart_async(provider, icao, self->cancellable,
+                                       docs_chart_fetched_cb, self);
         return;
     }
 
-    self->pdf_model = ev_document_model_new_with_document(self->pdf);
-    ev_view_set_model(EV_VIEW(self->pdf_view), self->pdf_model);
+    vfr_doc_cache_load(self->pdf_cache, self->pdf_key->str, file, docs_chart_loaded_cb, self);
+}
 
-    gtk_stack_set_visible_child_name(GTK_STACK(self->parent_stack), "pdf");
+static void data_selected_cb(GtkListBox *list_box, GtkListBoxRow *row, VFRDocsPage *self)
+{
+    const char *selected = hdy_action_row_get_subtitle(HDY_ACTION_ROW(row));
+
+    docs_open_chart(self, self->current_provider, selected);
+}
+
+static void search_selected_cb(GtkListBox *list_box, GtkListBoxRow *row, VFRDocsPage *self)
+{
+    guint index = gtk_list_box_row_get_index(row);
+    VFRSearchResult *result;
+
+    if (!self->search_results || index >= self->search_results->len)
+        return;
+
+    result = &g_array_index(self->search_results, VFRSearchResult, index);
+    self->current_provider = result->provider;
+    docs_open_chart(self, result->provider, vfr_terrain_get_icao(result->terrain));
 }
 
-static void docs_widget_add(VFRTerrain *terrain, VFRDocsPage *self)
+static void search_changed_cb(GtkSearchEntry *entry, VFRDocsPage *self)
 {
-    HdyActionRow *item = hdy_action_row_new();
-    hdy_action_row_set_subtitle(item, vfr_terrain_get_icao(terrain));
-    hdy_action_row_set_title(item, vfr_terrain_get_name(terrain));
-    gtk_list_box_insert(GTK_LIST_BOX(self->data_box), GTK_WIDGET(item), -1);
+    const gchar *query = gtk_entry_get_text(GTK_ENTRY(entry));
+
+    vfr_ui_empty_list_box(self->search_box);
+    if (self->search_results)
+        g_array_unref(self->search_results);
+    self->search_results = vfr_search_query(self->search, query, SEARCH_MAX_RESULTS);
+
+    for (guint i = 0; i < self->search_results->len; i++) {
+        VFRSearchResult *result = &g_array_index(self->search_results, VFRSearchResult, i);
+        HdyActionRow *item = hdy_action_row_new();
+        GString *subtitle = g_string_new(vfr_terrain_get_icao(result->terrain));
+
+        g_string_append_printf(subtitle, " - %s", vfr_provider_get_name(result->provider));
+        hdy_action_row_set_subtitle(item, subtitle->str);
+        hdy_action_row_set_title(item, vfr_terrain_get_name(result->terrain));
+        gtk_list_box_insert(GTK_LIST_BOX(self->search_box), GTK_WIDGET(item), -1);
+        g_string_free(subtitle, TRUE);
+    }
+
+    gtk_widget_show_all(self->search_box);
+    gtk_widget_set_visible(self->search_scroll, *query != 0);
+    gtk_widget_set_visible(self->list_box, *query == 0);
+}
+
+static GtkWidget *docs_create_row(gpointer item, gpointer data)
+{
+    VFRDocsPage *self = data;
+    VFRTerrain *terrain = vfr_terrain_item_get_terrain(VFR_TERRAIN_ITEM(item));
+    HdyActionRow *row = hdy_action_row_new();
+    GString *thumbnail;
+
+    hdy_action_row_set_subtitle(row, vfr_terrain_get_icao(terrain));
+    hdy_action_row_set_title(row, vfr_terrain_get_name(terrain));
+
+    thumbnail = vfr_preview_get_filename(self->current_provider, vfr_terrain_get_icao(terrain),
+                                         VFR_PREVIEW_THUMBNAIL);
+    if (g_file_test(thumbnail->str, G_FILE_TEST_EXISTS))
+        hdy_action_row_add_prefix(row, gtk_image_new_from_file(thumbnail->str));
+    g_string_free(thumbnail, TRUE);
+    gtk_widget_show_all(GTK_WIDGET(row));
+
+    return GTK_WIDGET(row);
+}
+
+/*
+ * Only the first page of terrains is bound, more rows are added when the
+ * user scrolls to the bottom of the list.
+ */
+static void data_edge_reached_cb(GtkScrolledWindow *scroll, GtkPositionType pos,
+                                 VFRDocsPage *self)
+{
+    VFRTerrainList *model;
+
+    if (pos != GTK_POS_BOTTOM || !self->current_provider)
+        return;
+
+    model = VFR_TERRAIN_LIST(vfr_provider_get_model(self->current_provider));
+    vfr_terrain_list_set_limit(model, vfr_terrain_list_get_limit(model) + DATA_PAGE_SIZE);
+}
+
+static void docs_show_provider(VFRDocsPage *self)
+{
+    GListModel *model = vfr_provider_get_model(self->current_provider);
+
+    gtk_label_set_label(GTK_LABEL(self->data_label), vfr_provider_get_name(self->current_provider));
+
+    vfr_terrain_list_set_limit(VFR_TERRAIN_LIST(model), DATA_PAGE_SIZE);
+    gtk_list_box_bind_model(GTK_LIST_BOX(self->data_box), model, docs_create_row, self, NULL);
 }
 
 static void provider_selected_cb(GtkListBox *list_box, GtkListBoxRow *row, VFRDocsPage *self)
 {
-    const char *selected = hdy_action_row_get_title(HDY_ACTION_ROW(row));
-    GtkListBoxRow *current;
-    HdyActionRow *item;
     guint index;
 
     index = gtk_list_box_row_get_index(row);
     if (index >= self->providers->len)
         return;
 
-    vfr_ui_empty_list_box(self->data_box);
-
     self->current_provider = self->providers->pdata[index];
-    gtk_label_set_label(GTK_LABEL(self->data_label), vfr_provider_get_name(self->current_provider));
+    docs_show_provider(self);
 
-    for (guint i = 0; i < vfr_provider_get_terrain_count(self->current_provider); i++) {
-        docs_widget_add(vfr_provider_get_terrain_by_index(self->current_provider, i), self);
+    gtk_stack_set_visible_child_name(GTK_STACK(self->parent_stack), "data-box");
+}
+
+static HdyActionRow *docs_get_provider_row(VFRDocsPage *self, VFRProvider *provider)
+{
+    for (guint i = 0; i < self->providers->len; i++) {
+        if (self->providers->pdata[i] == provider)
+            return self->provider_rows->pdata[i];
     }
 
-    gtk_widget_show_all(self->data_box);
-    gtk_stack_set_visible_child_name(GTK_STACK(self->parent_stack), "data-box");
+    return NULL;
+}
+
+void vfr_docs_page_sync_progress(VFRDocsPage *self, VFRProvider *provider, guint done,
+                                 guint total)
+{
+    HdyActionRow *row = docs_get_provider_row(self, provider);
+    GString *subtitle = g_string_new(NULL);
+
+    g_string_printf(subtitle, "Updating charts: %u/%u", done, total);
+    hdy_action_row_set_subtitle(row, subtitle->str);
+    g_string_free(subtitle, TRUE);
+}
+
+void vfr_docs_page_synced(VFRDocsPage *self, VFRProvider *provider, gboolean updated)
+{
+    gchar *prefix;
+
+    hdy_action_row_set_subtitle(docs_get_provider_row(self, provider), "");
+
+    if (!updated)
+        return;
+
+    // Only this provider's charts may have changed, see docs_open_chart()
+    prefix = g_strdup_printf("%s/", vfr_provider_get_id(provider));
+    vfr_doc_cache_invalidate(self->pdf_cache, prefix);
+    g_free(prefix);
+
+    // Terrains were reloaded, previous search results are no longer valid
+    vfr_search_free(self->search);
+    self->search = vfr_search_new(self->providers);
+    search_changed_cb(GTK_SEARCH_ENTRY(self->search_entry), self);
 }
 
 static void notify_visible_child_cb(GObject *object, GParamSpec *spec, gpointer data)
@@ -100,8 +286,8 @@ VFRDocsPage *vfr_docs_page_new (GtkWidget *stack, GtkWidget *menu_stack)
     GtkWidget *sublist;
     GtkWidget *scroll;
 
-    ev_init();
-    self->providers = vfr_provider_init();
+    vfr_loader_wait(VFR_LOADER_PROVIDERS);
+    self->providers = vfr_provider_get_all();
 
     self->parent_stack = stack;
     self->menu_stack = menu_stack;
@@ -118,6 +304,24 @@ VFRDocsPage *vfr_docs_page_new (GtkWidget *stack, GtkWidget *menu_stack)
     gtk_label_set_attributes(GTK_LABEL(self->label), attr_list);
     gtk_box_pack_start(GTK_BOX(box), self->label, FALSE, TRUE, 0);
 
+    self->provider_rows = g_ptr_array_new();
+    self->cancellable = g_cancellable_new();
+    self->search = vfr_search_new(self->providers);
+
+    self->search_entry = gtk_search_entry_new();
+    gtk_widget_set_margin_bottom(self->search_entry, 12);
+    g_signal_connect(self->search_entry, "search-changed", G_CALLBACK(search_changed_cb), self);
+    gtk_box_pack_start(GTK_BOX(box), self->search_entry, FALSE, TRUE, 0);
+
+    self->search_scroll = gtk_scrolled_window_new(NULL, NULL);
+    self->search_box = gtk_list_box_new();
+    gtk_list_box_set_selection_mode(GTK_LIST_BOX(self->search_box), GTK_SELECTION_NONE);
+    gtk_style_context_add_class(gtk_widget_get_style_context(self->search_box), "frame");
+    g_signal_connect(self->search_box, "row-activated", G_CALLBACK(search_selected_cb), self);
+    gtk_container_add(GTK_CONTAINER(self->search_scroll), self->search_box);
+    gtk_widget_set_no_show_all(self->search_scroll, TRUE);
+    gtk_box_pack_start(GTK_BOX(box), self->search_scroll, TRUE, TRUE, 0);
+
     self->list_box = gtk_list_box_new();
     gtk_list_box_set_selection_mode(GTK_LIST_BOX(self->list_box), GTK_SELECTION_NONE);
     gtk_style_context_add_class(gtk_widget_get_style_context(self->list_box), "frame");
@@ -132,6 +336,7 @@ VFRDocsPage *vfr_docs_page_new (GtkWidget *stack, GtkWidget *menu_stack)
         hdy_action_row_add_action(list_item, button);
         g_object_bind_property(button, "state", list_item, "activatable", G_BINDING_SYNC_CREATE);
         gtk_list_box_insert(GTK_LIST_BOX(self->list_box), GTK_WIDGET(list_item), -1);
+        g_ptr_array_add(self->provider_rows, list_item);
     }
 
     g_signal_connect(self->list_box, "row-activated", G_CALLBACK(provider_selected_cb), self);
@@ -158,6 +363,8 @@ VFRDocsPage *vfr_docs_page_new (GtkWidget *stack, GtkWidget *menu_stack)
     gtk_style_context_add_class(gtk_widget_get_style_context(self->data_box), "frame");
     g_signal_connect(self->data_box, "row-activated", G_CALLBACK(data_selected_cb), self);
 
+    g_signal_connect(scroll, "edge-reached", G_CALLBACK(data_edge_reached_cb), self);
+
     gtk_container_add(GTK_CONTAINER(scroll), self->data_box);
     gtk_box_pack_start(GTK_BOX(box), scroll, TRUE, TRUE, 0);
 
@@ -165,9 +372,19 @@ VFRDocsPage *vfr_docs_page_new (GtkWidget *stack, GtkWidget *menu_stack)
 
     scroll = gtk_scrolled_window_new(NULL, NULL);
     self->pdf_view = ev_view_new();
+    self->pdf_model = ev_document_model_new();
+    self->pdf_cache = vfr_doc_cache_new(0);
+    self->pdf_key = g_string_new(NULL);
+    ev_view_set_model(EV_VIEW(self->pdf_view), self->pdf_model);
     gtk_container_add(GTK_CONTAINER(scroll), self->pdf_view);
     gtk_stack_add_named(GTK_STACK(stack), scroll, "pdf");
 
+    scroll = gtk_scrolled_window_new(NULL, NULL);
+    self->pdf_preview = gtk_image_new();
+    gtk_widget_set_valign(self->pdf_preview, GTK_ALIGN_START);
+    gtk_container_add(GTK_CONTAINER(scroll), self->pdf_preview);
+    gtk_stack_add_named(GTK_STACK(stack), scroll, "preview");
+
     g_signal_connect(stack, "notify::visible-child",
                      G_CALLBACK(notify_visible_child_cb), self);
 
@@ -180,7 +397,7 @@ void vfr_docs_page_back(VFRDocsPage *self)
 
     if (g_str_equal(visible, "data-box")) {
         gtk_stack_set_visible_child_name(GTK_STACK(self->parent_stack), "list-box");
-    } else if (g_str_equal(visible, "pdf")) {
+    } else if (g_str_equal(visible, "pdf") || g_str_equal(visible, "preview")) {
         gtk_stack_set_visible_child_name(GTK_STACK(self->parent_stack), "data-box");
     }
 }
@@ -14,9 +14,15 @@
 #define HANDY_USE_UNSTABLE_API
 #include <handy.h>
 
+#include "provider.h"
+
 typedef struct _VFRDocsPage VFRDocsPage;
 
 VFRDocsPage *vfr_docs_page_new(GtkWidget *stack, GtkWidget *menu_stack);
 void vfr_docs_page_back(VFRDocsPage *self);
 
+void vfr_docs_page_sync_progress(VFRDocsPage *self, VFRProvider *provider, guint done,
+                                 guint total);
+void vfr_docs_page_synced(VFRDocsPage *self, VFRProvider *provider, gboolean updated);
+
 #endif /* _VFR_DOCS_PAGE_H */
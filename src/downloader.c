@@ -0,0 +1,874 @@
+/*
+ * (C) Copyright 2019, Arnaud Ferraris <arnaud.ferraris@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ */
+
+#include "downloader.h"
+
+#include "net-policy.h"
+
+#include <string.h>
+#include <unistd.h>
+
+#include <curl/curl.h>
+#include <glib/gstdio.h>
+
+struct _VFRDownload {
+    GString *url;
+    GString *filename;
+    GString *partname;
+    GString *validator_file;
+    FILE *file;
+    CURL *curl;
+    struct curl_slist *headers;
+    glong status;
+
+    // Validators from the previous download, sent as conditional headers
+    GString *old_etag;
+    GString *old_last_modified;
+    GString *old_hash;
+
+    // Validators received with the response
+    GString *etag;
+    GString *last_modified;
+    GChecksum *checksum;
+    GString *hash;
+    goffset size;
+    goffset received;
+    gboolean modified;
+
+    // Resuming state: `offset` bytes were already in the partial file
+    GString *validator;
+    GString *trailer;
+    goffset offset;
+    goffset expected;
+    goffset content_length;
+    goffset range_start;
+    goffset range_total;
+    gboolean discard;
+    gboolean bad_range;
+
+    gint64 priority;
+
+    // Timings of every attempt, retries included
+    GArray *timings;
+
+    // Failed attempts so far, and when the next one may start
+    guint attempts;
+    gint64 retry_time;
+
+    vfr_download_cb callback;
+    gpointer data;
+};
+
+struct _VFRDownloader {
+    CURLM *multi;
+    guint max_transfers;
+    guint active;
+    GCancellable *cancellable;
+
+    GQueue *pending;
+    GQueue *retries;
+    GQueue *transfers;
+    GQueue *handles;
+    gboolean unsorted;
+};
+
+static guint downloader_default_transfers(void)
+{
+    const gchar *env = g_getenv("LIBREVFR_MAX_TRANSFERS");
+    guint64 value;
+
+    if (env) {
+        value = g_ascii_strtoull(env, NULL, 10);
+        if (value > 0 && value <= 64)
+            return (guint)value;
+    }
+
+    return VFR_DOWNLOADER_DEFAULT_TRANSFERS;
+}
+
+static void download_free(VFRDownload *download)
+{
+    g_string_free(download->url, TRUE);
+    g_string_free(download->filename, TRUE);
+    g_string_free(download->partname, TRUE);
+    g_string_free(download->validator_file, TRUE);
+    g_string_free(download->validator, TRUE);
+    g_string_free(download->trailer, TRUE);
+    g_string_free(download->old_etag, TRUE);
+    g_string_free(download->old_last_modified, TRUE);
+    g_string_free(download->old_hash, TRUE);
+    g_string_free(download->etag, TRUE);
+    g_string_free(download->last_modified, TRUE);
+    g_string_free(download->hash, TRUE);
+    g_array_free(download->timings, TRUE);
+    if (download->checksum)
+        g_checksum_free(download->checksum);
+    if (download->headers)
+        curl_slist_free_all(download->headers);
+    g_free(download);
+}
+
+static size_t download_write_cb(char *ptr, size_t size, size_t nmemb, void *userdata)
+{
+    VFRDownload *download = userdata;
+    size_t len = size * nmemb;
+
+    download->received += len;
+
+    // Body of an error page, a redirect or a "304 Not Modified" response
+    if (download->discard)
+        return len;
+
+    if (fwrite(ptr, 1, len, download->file) != len)
+        return 0;
+
+    g_checksum_update(download->checksum, (const guchar *)ptr, len);
+    download->size += len;
+
+    return len;
+}
+
+// Restart from scratch, the partial file can't be used
+static gboolean download_restart(VFRDownload *download)
+{
+    download->file = freopen(download->partname->str, "wb", download->file);
+    if (!download->file)
+        return FALSE;
+
+    g_checksum_reset(download->checksum);
+    download->offset = 0;
+    download->size = 0;
+
+    return TRUE;
+}
+
+/*
+ * Called once the headers of each response were received: decide what to do
+ * with its body and how long the complete file should be.
+ */
+static void download_headers_done(VFRDownload *download)
+{
+    const gchar *validator;
+    glong status = 0;
+
+    curl_easy_getinfo(download->curl, CURLINFO_RESPONSE_CODE, &status);
+    download->discard = (status != 0 && status != 200 && status != 206);
+    download->expected = -1;
+
+    if (status == 206) {
+        // Not the part we asked for, see downloader_retry_full()
+        if (download->range_start != download->offset) {
+            download->bad_range = TRUE;
+            return;
+        }
+
+        if (download->range_total > 0)
+            download->expected = download->range_total;
+        else if (download->content_length >= 0)
+            download->expected = download->offset + download->content_length;
+        return;
+    }
+
+    if (status != 200)
+        return;
+
+    // The server ignored the range, or the file changed since last time
+    if (download->offset > 0 && !download_restart(download)) {
+        download->discard = TRUE;
+        return;
+    }
+
+    download->expected = download->content_length;
+
+    // Remember which version of the file the partial download belongs to
+    validator = download->etag->len > 0 && !g_str_has_prefix(download->etag->str, "W/") ?
+                download->etag->str : download->last_modified->str;
+    if (validator[0])
+        g_file_set_contents(download->validator_file->str, validator, -1, NULL);
+    else
+        g_remove(download->validator_file->str);
+}
+
+// Content-Range: bytes <start>-<end>/<total>
+static void download_parse_range(VFRDownload *download, const gchar *value)
+{
+    if (g_str_has_prefix(value, "bytes "))
+        download->range_start = g_ascii_strtoll(value + strlen("bytes "), NULL, 10);
+    download->range_total = g_ascii_strtoll(strchr(value, '/') + 1, NULL, 10);
+}
+
+static size_t download_header_cb(char *buffer, size_t size, size_t nitems, void *userdata)
+{
+    VFRDownload *download = userdata;
+    size_t len = size * nitems;
+    gchar *line = g_strndup(buffer, len);
+    gchar *value;
+
+    g_strchomp(line);
+
+    if (g_str_has_prefix(line, "HTTP/")) {
+        // New response (e.g. after a redirect), forget previous headers
+        g_string_truncate(download->etag, 0);
+        g_string_truncate(download->last_modified, 0);
+        download->content_length = -1;
+        download->range_start = -1;
+        download->range_total = -1;
+    } else if (line[0] == 0) {
+        download_headers_done(download);
+    } else if ((value = strchr(line, ':'))) {
+        *value++ = 0;
+        value = g_strstrip(value);
+
+        if (!g_ascii_strcasecmp(line, "ETag"))
+            g_string_assign(download->etag, value);
+        else if (!g_ascii_strcasecmp(line, "Last-Modified"))
+            g_string_assign(download->last_modified, value);
+        else if (!g_ascii_strcasecmp(line, "Content-Length"))
+            download->content_length = g_ascii_strtoll(value, NULL, 10);
+        else if (!g_ascii_strcasecmp(line, "Content-Range") && strchr(value, '/'))
+            download_parse_range(download, value);
+    }
+
+    g_free(line);
+
+    // Returning a short count makes curl abort the transfer
+    return download->bad_range ? 0 : len;
+}
+
+static void downloader_complete(VFRDownloader *self, VFRDownload *download, gboolean success)
+{
+    if (download->callback)
+        download->callback(download, success, download->data);
+
+    download_free(download);
+}
+
+/*
+ * A partial file left by an interrupted transfer is resumed if we know
+ * which version of the remote file it holds. Its content is hashed again,
+ * so that the checksum of the complete file is still computed.
+ */
+static void download_prepare_resume(VFRDownload *download)
+{
+    gchar *validator = NULL;
+    guchar buffer[65536];
+    GStatBuf st;
+    gsize len;
+    FILE *file;
+
+    download->offset = 0;
+
+    if (g_stat(download->partname->str, &st) < 0 || st.st_size == 0 ||
+        !g_file_get_contents(download->validator_file->str, &validator, NULL, NULL)) {
+        return;
+    }
+
+    g_string_assign(download->validator, g_strstrip(validator));
+    g_free(validator);
+
+    file = g_fopen(download->partname->str, "rb");
+    if (!file || download->validator->len == 0) {
+        if (file)
+            fclose(file);
+        return;
+    }
+
+    while ((len = fread(buffer, 1, sizeof(buffer), file)) > 0)
+        g_checksum_update(download->checksum, buffer, len);
+    fclose(file);
+
+    download->offset = st.st_size;
+    download->size = st.st_size;
+}
+
+/*
+ * Easy handles are recycled rather than destroyed: together with the
+ * multi handle's connection cache, this lets consecutive transfers to the
+ * same host reuse an already established (and TLS-negotiated) connection.
+ */
+static gboolean downloader_start(VFRDownloader *self, VFRDownload *download)
+{
+    // Refuse to wait for a host which is known to be unavailable
+    if (!vfr_net_host_allowed(download->url->str))
+        return FALSE;
+
+    download->checksum = g_checksum_new(G_CHECKSUM_SHA256);
+    download_prepare_resume(download);
+
+    download->file = g_fopen(download->partname->str, download->offset > 0 ? "ab" : "wb");
+    if (!download->file)
+        return FALSE;
+
+    if (download->old_etag->len > 0) {
+        GString *header = g_string_new(NULL);
+
+        g_string_printf(header, "If-None-Match: %s", download->old_etag->str);
+        download->headers = curl_slist_append(download->headers, header->str);
+        g_string_free(header, TRUE);
+    }
+    if (download->old_last_modified->len > 0) {
+        GString *header = g_string_new(NULL);
+
+        g_string_printf(header, "If-Modified-Since: %s", download->old_last_modified->str);
+        download->headers = curl_slist_append(download->headers, header->str);
+        g_string_free(header, TRUE);
+    }
+    if (download->offset > 0) {
+        GString *header = g_string_new(NULL);
+
+        // The server sends the whole file if it changed since the partial one
+        g_string_printf(header, "If-Range: %s", download->validator->str);
+        download->headers = curl_slist_append(download->headers, header->str);
+        g_string_free(header, TRUE);
+    }
+
+    download->curl = g_queue_pop_head(self->handles);
+    if (download->curl)
+        curl_easy_reset(download->curl);
+    else
+        download->curl = curl_easy_init();
+
+    vfr_net_policy_apply(download->curl);
+    curl_easy_setopt(download->curl, CURLOPT_URL, download->url->str);
+    curl_easy_setopt(download->curl, CURLOPT_HTTPHEADER, download->headers);
+    curl_easy_setopt(download->curl, CURLOPT_WRITEFUNCTION, download_write_cb);
+    curl_easy_setopt(download->curl, CURLOPT_WRITEDATA, download);
+    curl_easy_setopt(download->curl, CURLOPT_HEADERFUNCTION, download_header_cb);
+    curl_easy_setopt(download->curl, CURLOPT_HEADERDATA, download);
+    curl_easy_setopt(download->curl, CURLOPT_PRIVATE, download);
+    /*
+     * Unlike CURLOPT_RESUME_FROM_LARGE, a plain range lets curl accept the
+     * whole file when the server ignores it or the file changed (If-Range),
+     * in which case download_headers_done() restarts the partial file.
+     */
+    if (download->offset > 0) {
+        gchar *range = g_strdup_printf("%" G_GOFFSET_FORMAT "-", download->offset);
+
+        curl_easy_setopt(download->curl, CURLOPT_RANGE, range);
+        g_free(range);
+    }
+
+    curl_multi_add_handle(self->multi, download->curl);
+    g_queue_push_tail(self->transfers, download);
+    self->active++;
+
+    return TRUE;
+}
+
+// Start downloads up to the transfers limit, FALSE if any couldn't start
+static gboolean downloader_fill(VFRDownloader *self)
+{
+    VFRDownload *download;
+    gint64 now = g_get_monotonic_time();
+    gboolean result = TRUE;
+
+    while (self->active < self->max_transfers) {
+        // Retries are sorted by time, and go before downloads not tried yet
+        download = g_queue_peek_head(self->retries);
+        if (download && download->retry_time <= now)
+            download = g_queue_pop_head(self->retries);
+        else
+            download = g_queue_pop_head(self->pending);
+        if (!download)
+            break;
+
+        if (!downloader_start(self, download)) {
+            downloader_complete(self, download, FALSE);
+            result = FALSE;
+        }
+    }
+
+    return result;
+}
+
+static void download_discard_part(VFRDownload *download)
+{
+    g_remove(download->partname->str);
+    g_remove(download->validator_file->str);
+}
+
+// Binary data (e.g. compressed streams in PDFs) may hold NUL bytes
+static gboolean download_find(const gchar *buffer, gsize len, const GString *needle)
+{
+    for (gsize i = 0; needle->len <= len && i <= len - needle->len; i++) {
+        if (memcmp(buffer + i, needle->str, needle->len) == 0)
+            return TRUE;
+    }
+
+    return FALSE;
+}
+
+// Check the length and (if any) the expected trailer of the received file
+static gboolean download_is_valid(VFRDownload *download)
+{
+    gchar buffer[1024];
+    gsize len;
+    FILE *file;
+
+    if (download->expected >= 0 && download->size != download->expected)
+        return FALSE;
+
+    if (download->trailer->len == 0)
+        return TRUE;
+
+    file = g_fopen(download->partname->str, "rb");
+    if (!file)
+        return FALSE;
+
+    // Some generators append a few bytes of padding after the trailer
+    if (download->size > (goffset)sizeof(buffer))
+        fseeko(file, -(off_t)sizeof(buffer), SEEK_END);
+    len = fread(buffer, 1, sizeof(buffer), file);
+    fclose(file);
+
+    return download_find(buffer, len, download->trailer);
+}
+
+static gint downloader_compare_retry(gconstpointer a, gconstpointer b, gpointer data)
+{
+    const VFRDownload *da = a;
+    const VFRDownload *db = b;
+
+    if (da->retry_time == db->retry_time)
+        return 0;
+
+    return da->retry_time < db->retry_time ? -1 : 1;
+}
+
+// Forget the state of the previous attempt before the download is started again
+static void download_reset(VFRDownload *download)
+{
+    g_checksum_free(download->checksum);
+    download->checksum = NULL;
+    curl_slist_free_all(download->headers);
+    download->headers = NULL;
+    download->size = 0;
+    download->status = 0;
+    download->bad_range = FALSE;
+}
+
+/*
+ * The partial file doesn't match the remote one: the server refused the
+ * range (416), or sent another part than the requested one. Drop it and
+ * download the whole file right away, which doesn't count as an attempt.
+ */
+static gboolean downloader_retry_full(VFRDownloader *self, VFRDownload *download)
+{
+    if (download->offset == 0 || (download->status != 416 && !download->bad_range) ||
+        g_cancellable_is_cancelled(self->cancellable)) {
+        return FALSE;
+    }
+
+    download_discard_part(download);
+    download_reset(download);
+    download->retry_time = g_get_monotonic_time();
+    g_queue_insert_sorted(self->retries, download, downloader_compare_retry, NULL);
+
+    return TRUE;
+}
+
+/*
+ * Transient failures (timeouts, server errors, throttling...) are retried a
+ * few times, after a delay growing with each attempt. The partial file is
+ * kept when possible, so that the next attempt resumes it.
+ */
+static gboolean downloader_retry(VFRDownloader *self, VFRDownload *download, CURLcode result)
+{
+    if (!vfr_net_is_transient(result, download->status) ||
+        download->attempts >= VFR_NET_MAX_RETRIES ||
+        g_cancellable_is_cancelled(self->cancellable)) {
+        return FALSE;
+    }
+
+    if (!g_file_test(download->validator_file->str, G_FILE_TEST_EXISTS))
+        download_discard_part(download);
+
+    download_reset(download);
+    download->retry_time = g_get_monotonic_time() + vfr_net_get_backoff(download->attempts);
+    download->attempts++;
+    g_queue_insert_sorted(self->retries, download, downloader_compare_retry, NULL);
+
+    return TRUE;
+}
+
+static gboolean downloader_finish(VFRDownloader *self, VFRDownload *download, CURLcode result)
+{
+    gboolean success;
+
+    curl_easy_getinfo(download->curl, CURLINFO_RESPONSE_CODE, &download->status);
+    g_array_set_size(download->timings, download->timings->len + 1);
+    vfr_net_timing_init(&g_array_index(download->timings, VFRNetTiming,
+                                       download->timings->len - 1),
+                        download->curl, result);
+    vfr_net_host_report(download->url->str, result, download->status);
+    curl_multi_remove_handle(self->multi, download->curl);
+    g_queue_push_tail(self->handles, download->curl);
+    download->curl = NULL;
+    g_queue_remove(self->transfers, download);
+    self->active--;
+
+    if (download->file)
+        fclose(download->file);
+    download->file = NULL;
+
+    // Not completed yet: the download is pending again
+    if (downloader_retry_full(self, download) || downloader_retry(self, download, result))
+        return TRUE;
+
+    // Status is 0 for non-HTTP URLs (e.g. file://)
+    success = (result == CURLE_OK) &&
+              (download->status == 0 || download->status == 304 ||
+               (download->status >= 200 && download->status < 300));
+
+    if (success && download->status != 304 && !download_is_valid(download)) {
+        printf("%s: invalid file received (%" G_GOFFSET_FORMAT " bytes)\n",
+               download->url->str, download->size);
+        success = FALSE;
+        download_discard_part(download);
+    }
+
+    if (success && download->status != 304) {
+        g_string_assign(download->hash, g_checksum_get_string(download->checksum));
+
+        /*
+         * Servers which don't support conditional requests still send the
+         * whole file: only replace the existing one if its content changed.
+         */
+        if (!g_string_equal(download->hash, download->old_hash) ||
+            !g_file_test(download->filename->str, G_FILE_TEST_EXISTS)) {
+            download->modified = TRUE;
+            if (g_rename(download->partname->str, download->filename->str) < 0)
+                success = FALSE;
+        }
+    } else if (success) {
+        GStatBuf st;
+
+        // Not modified: the validators and content we had are still valid
+        g_string_assign(download->hash, download->old_hash->str);
+        if (download->etag->len == 0)
+            g_string_assign(download->etag, download->old_etag->str);
+        if (download->last_modified->len == 0)
+            g_string_assign(download->last_modified, download->old_last_modified->str);
+        if (g_stat(download->filename->str, &st) == 0)
+            download->size = st.st_size;
+    }
+
+    /*
+     * Keep the partial file of an interrupted transfer so that the next
+     * attempt resumes it, unless the server can't tell us it's still valid.
+     */
+    if (success || download->status == 416 || download->status == 304 ||
+        !g_file_test(download->validator_file->str, G_FILE_TEST_EXISTS)) {
+        download_discard_part(download);
+    }
+
+    downloader_complete(self, download, success);
+
+    return success;
+}
+
+static void downloader_cancel(VFRDownloader *self)
+{
+    VFRDownload *download;
+
+    while ((download = g_queue_peek_head(self->transfers)))
+        downloader_finish(self, download, CURLE_ABORTED_BY_CALLBACK);
+
+    while ((download = g_queue_pop_head(self->retries)))
+        downloader_complete(self, download, FALSE);
+
+    while ((download = g_queue_pop_head(self->pending)))
+        downloader_complete(self, download, FALSE);
+}
+
+VFRDownloader *vfr_downloader_new(guint max_transfers)
+{
+    VFRDownloader *self = g_malloc0(sizeof(VFRDownloader));
+
+    if (max_transfers == 0)
+        max_transfers = downloader_default_transfers();
+
+    self->max_transfers = max_transfers;
+    self->pending = g_queue_new();
+    self->retries = g_queue_new();
+    self->transfers = g_queue_new();
+    self->handles = g_queue_new();
+
+    self->multi = curl_multi_init();
+    curl_multi_setopt(self->multi, CURLMOPT_MAX_HOST_CONNECTIONS, (long)max_transfers);
+    curl_multi_setopt(self->multi, CURLMOPT_MAX_TOTAL_CONNECTIONS, (long)max_transfers);
+    curl_multi_setopt(self->multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+
+    return self;
+}
+
+void vfr_downloader_free(VFRDownloader *self)
+{
+    CURL *curl;
+
+    if (!self)
+        return;
+
+    downloader_cancel(self);
+    g_queue_free(self->pending);
+    g_queue_free(self->retries);
+    g_queue_free(self->transfers);
+    g_clear_object(&self->cancellable);
+    while ((curl = g_queue_pop_head(self->handles)))
+        curl_easy_cleanup(curl);
+    g_queue_free(self->handles);
+
+    curl_multi_cleanup(self->multi);
+    g_free(self);
+}
+
+void vfr_downloader_set_cancellable(VFRDownloader *self, GCancellable *cancellable)
+{
+    if (!self)
+        return;
+
+    g_clear_object(&self->cancellable);
+    if (cancellable)
+        self->cancellable = g_object_ref(cancellable);
+}
+
+/*
+ * The returned download belongs to the downloader and may only be used
+ * until its completion callback returns.
+ */
+VFRDownload *vfr_downloader_add(VFRDownloader *self, const gchar *url, const gchar *filename,
+                                vfr_download_cb callback, gpointer data)
+{
+    VFRDownload *download;
+
+    if (!self || !url || !filename)
+        return NULL;
+
+    download = g_malloc0(sizeof(VFRDownload));
+    download->url = g_string_new(url);
+    download->filename = g_string_new(filename);
+    download->partname = g_string_new(filename);
+    g_string_append(download->partname, ".part");
+    download->validator_file = g_string_new(download->partname->str);
+    g_string_append(download->validator_file, ".validator");
+    download->validator = g_string_new(NULL);
+    download->trailer = g_string_new(NULL);
+    download->expected = -1;
+    download->old_etag = g_string_new(NULL);
+    download->old_last_modified = g_string_new(NULL);
+    download->old_hash = g_string_new(NULL);
+    download->etag = g_string_new(NULL);
+    download->last_modified = g_string_new(NULL);
+    download->hash = g_string_new(NULL);
+    download->timings = g_array_new(FALSE, FALSE, sizeof(VFRNetTiming));
+    download->callback = callback;
+    download->data = data;
+
+    g_queue_push_tail(self->pending, download);
+    self->unsorted = TRUE;
+
+    return download;
+}
+
+static gint downloader_compare_priority(gconstpointer a, gconstpointer b, gpointer data)
+{
+    const VFRDownload *da = a;
+    const VFRDownload *db = b;
+
+    if (da->priority == db->priority)
+        return 0;
+
+    return da->priority > db->priority ? -1 : 1;
+}
+
+gboolean vfr_downloader_run(VFRDownloader *self)
+{
+    gboolean result = TRUE;
+    int running;
+    int left;
+
+    if (!self)
+        return FALSE;
+
+    // Downloads of equal priority keep the order they were added in
+    if (self->unsorted) {
+        g_queue_sort(self->pending, downloader_compare_priority, NULL);
+        self->unsorted = FALSE;
+    }
+
+    result = downloader_fill(self);
+
+    while (self->active > 0 || !g_queue_is_empty(self->retries)) {
+        VFRDownload *next;
+        CURLMsg *msg;
+        int timeout = 1000;
+
+        if (g_cancellable_is_cancelled(self->cancellable)) {
+            downloader_cancel(self);
+            return FALSE;
+        }
+
+        if (curl_multi_perform(self->multi, &running) != CURLM_OK) {
+            result = FALSE;
+            break;
+        }
+
+        while ((msg = curl_multi_info_read(self->multi, &left))) {
+            VFRDownload *download;
+            CURLcode code;
+
+            if (msg->msg != CURLMSG_DONE)
+                continue;
+
+            code = msg->data.result;
+            curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, (char **)&download);
+            if (!downloader_finish(self, download, code))
+                result = FALSE;
+        }
+
+        if (!downloader_fill(self))
+            result = FALSE;
+
+        // Don't wait past the time the next retry is due
+        next = g_queue_peek_head(self->retries);
+        if (next) {
+            gint64 delay = next->retry_time - g_get_monotonic_time();
+
+            timeout = CLAMP(delay / 1000, 0, timeout);
+        }
+
+        // curl_multi_wait() returns immediately when there are no transfers
+        if (running > 0)
+            curl_multi_wait(self->multi, NULL, 0, timeout, NULL);
+        else if (next)
+            g_usleep((gulong)timeout * 1000);
+    }
+
+    return result && g_queue_is_empty(self->pending);
+}
+
+const gchar *vfr_download_get_url(VFRDownload *download)
+{
+    if (download)
+        return download->url->str;
+
+    return NULL;
+}
+
+const gchar *vfr_download_get_filename(VFRDownload *download)
+{
+    if (download)
+        return download->filename->str;
+
+    return NULL;
+}
+
+glong vfr_download_get_status(VFRDownload *download)
+{
+    if (download)
+        return download->status;
+
+    return 0;
+}
+
+void vfr_download_set_validators(VFRDownload *download, const gchar *etag,
+                                 const gchar *last_modified, const gchar *hash)
+{
+    if (!download)
+        return;
+
+    g_string_assign(download->old_etag, etag ? etag : "");
+    g_string_assign(download->old_last_modified, last_modified ? last_modified : "");
+    g_string_assign(download->old_hash, hash ? hash : "");
+}
+
+// Downloads with a higher priority are started first
+void vfr_download_set_priority(VFRDownload *download, gint64 priority)
+{
+    if (download)
+        download->priority = priority;
+}
+
+// Files not ending with `trailer` (e.g. "%%EOF" for PDFs) are rejected
+void vfr_download_set_trailer(VFRDownload *download, const gchar *trailer)
+{
+    if (download)
+        g_string_assign(download->trailer, trailer ? trailer : "");
+}
+
+/*
+ * The file is received as `partname` (by default, the file name followed by
+ * ".part") and atomically renamed once complete: concurrent downloads of the
+ * same file must each use their own.
+ */
+void vfr_download_set_partname(VFRDownload *download, const gchar *partname)
+{
+    if (!download || !partname)
+        return;
+
+    g_string_assign(download->partname, partname);
+    g_string_printf(download->validator_file, "%s.validator", partname);
+}
+
+gboolean vfr_download_is_modified(VFRDownload *download)
+{
+    if (download)
+        return download->modified;
+
+    return FALSE;
+}
+
+const gchar *vfr_download_get_etag(VFRDownload *download)
+{
+    if (download)
+        return download->etag->str;
+
+    return NULL;
+}
+
+const gchar *vfr_download_get_last_modified(VFRDownload *download)
+{
+    if (download)
+        return download->last_modified->str;
+
+    return NULL;
+}
+
+const gchar *vfr_download_get_hash(VFRDownload *download)
+{
+    if (download)
+        return download->hash->str;
+
+    return NULL;
+}
+
+goffset vfr_download_get_size(VFRDownload *download)
+{
+    if (download)
+        return download->size;
+
+    return 0;
+}
+
+/*
+ * Timings of each attempt (failed ones first), `count` being 0 if the
+ * request was never made.
+ */
+const VFRNetTiming *vfr_download_get_timings(VFRDownload *download, guint *count)
+{
+    *count = download ? download->timings->len : 0;
+
+    return download ? (const VFRNetTiming *)download->timings->data : NULL;
+}
+
+// Number of bytes actually transferred, lower than the size when resuming
+goffset vfr_download_get_received(VFRDownload *download)
+{
+    if (download)
+        return download->received;
+
+    return 0;
+}
@@ -0,0 +1,47 @@
+/*
+ * (C) Copyright 2019, Arnaud Ferraris <arnaud.ferraris@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ */
+
+#ifndef _VFR_DOWNLOADER_H
+#define _VFR_DOWNLOADER_H
+
+#include <gio/gio.h>
+
+#include "net-stats.h"
+
+#define VFR_DOWNLOADER_DEFAULT_TRANSFERS 8
+
+typedef struct _VFRDownloader VFRDownloader;
+typedef struct _VFRDownload VFRDownload;
+
+typedef void (*vfr_download_cb)(VFRDownload *download, gboolean success, gpointer data);
+
+VFRDownloader *vfr_downloader_new(guint max_transfers);
+void vfr_downloader_free(VFRDownloader *self);
+
+void vfr_downloader_set_cancellable(VFRDownloader *self, GCancellable *cancellable);
+
+VFRDownload *vfr_downloader_add(VFRDownloader *self, const gchar *url, const gchar *filename,
+                                vfr_download_cb callback, gpointer data);
+gboolean vfr_downloader_run(VFRDownloader *self);
+
+const gchar *vfr_download_get_url(VFRDownload *download);
+const gchar *vfr_download_get_filename(VFRDownload *download);
+glong vfr_download_get_status(VFRDownload *download);
+
+void vfr_download_set_validators(VFRDownload *download, const gchar *etag,
+                                 const gchar *last_modified, const gchar *hash);
+void vfr_download_set_priority(VFRDownload *download, gint64 priority);
+void vfr_download_set_trailer(VFRDownload *download, const gchar *trailer);
+void vfr_download_set_partname(VFRDownload *download, const gchar *partname);
+gboolean vfr_download_is_modified(VFRDownload *download);
+const gchar *vfr_download_get_etag(VFRDownload *download);
+const gchar *vfr_download_get_last_modified(VFRDownload *download);
+const gchar *vfr_download_get_hash(VFRDownload *download);
+goffset vfr_download_get_size(VFRDownload *download);
+goffset vfr_download_get_received(VFRDownload *download);
+const VFRNetTiming *vfr_download_get_timings(VFRDownload *download, guint *count);
+
+#endif /* _VFR_DOWNLOADER_H */
@@ -6,6 +6,8 @@
 
 #include "flight.h"
 
+#include "loader.h"
+
 #include <json-glib/json-glib.h>
 
 struct _VFRFlight {
@@ -52,7 +54,7 @@ static VFRFlight *vfr_flight_load_from_file(const gchar *filename)
     flight->origin = g_string_new(json_object_get_string_member(object, "origin"));
     flight->orig_icao = g_string_new(json_object_get_string_member(object, "orig_icao"));
     flight->destination = g_string_new(json_object_get_string_member(object, "destination"));
-    flight->dest_icao = g_string_new(json_object_get_string_member(object, "orig_icao"));
+    flight->dest_icao = g_string_new(json_object_get_string_member(object, "dest_icao"));
 
     array = json_object_get_array_member(object, "legs");
     leg_count = json_array_get_length(array);
@@ -112,6 +114,7 @@ static gboolean vfr_flight_load()
     return TRUE;
 }
 
+// Called once, from vfr_loader_start() or when flights are first needed
 gboolean vfr_flight_init()
 {
     flight_list = g_malloc0(sizeof(VFRFlightList));
@@ -122,6 +125,8 @@ gboolean vfr_flight_init()
 
 guint vfr_flight_get_count()
 {
+    vfr_loader_wait(VFR_LOADER_FLIGHTS);
+
     if (flight_list)
         return flight_list->list->len;
 
@@ -130,6 +135,8 @@ guint vfr_flight_get_count()
 
 VFRFlight *vfr_flight_get(guint index)
 {
+    vfr_loader_wait(VFR_LOADER_FLIGHTS);
+
     if (flight_list && flight_list->list->len > index)
         return flight_list->list->pdata[index];
 
@@ -153,6 +160,37 @@ const gchar *vfr_flight_get_name(VFRFlight *flight)
     return NULL;
 }
 
+const gchar *vfr_flight_get_orig_icao(VFRFlight *flight)
+{
+    if (flight)
+        return flight->orig_icao->str;
+
+    return NULL;
+}
+
+const gchar *vfr_flight_get_dest_icao(VFRFlight *flight)
+{
+    if (flight)
+        return flight->dest_icao->str;
+
+    return NULL;
+}
+
+// Whether an airfield is the origin or destination of a stored flight
+gboolean vfr_flight_uses_airfield(const gchar *icao)
+{
+    for (guint i = 0; icao && i < vfr_flight_get_count(); i++) {
+        VFRFlight *flight = vfr_flight_get(i);
+
+        if (!g_ascii_strcasecmp(flight->orig_icao->str, icao) ||
+            !g_ascii_strcasecmp(flight->dest_icao->str, icao)) {
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
 guint vfr_flight_get_leg_count(VFRFlight *flight)
 {
     if (flight)
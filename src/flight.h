@@ -25,6 +25,10 @@ VFRFlight *vfr_flight_get(guint index);
 
 const gchar *vfr_flight_get_label(VFRFlight *flight);
 const gchar *vfr_flight_get_name(VFRFlight *flight);
+const gchar *vfr_flight_get_orig_icao(VFRFlight *flight);
+const gchar *vfr_flight_get_dest_icao(VFRFlight *flight);
+
+gboolean vfr_flight_uses_airfield(const gchar *icao);
 
 guint vfr_flight_get_leg_count(VFRFlight *flight);
 VFRFlightLeg *vfr_flight_get_leg(VFRFlight *flight, guint index);
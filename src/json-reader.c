@@ -0,0 +1,271 @@
+/*
+ * (C) Copyright 2019, Arnaud Ferraris <arnaud.ferraris@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ */
+
+#include "json-reader.h"
+
+/*
+ * Event-based JSON reader, fed with arbitrary chunks of data as they are
+ * received. Only the current token and the stack of open containers are
+ * kept in memory, whatever the size of the document. The grammar is only
+ * loosely checked: unbalanced containers and broken strings are errors,
+ * misplaced separators are not.
+ */
+
+typedef enum {
+    JSON_STATE_DEFAULT = 0,
+    JSON_STATE_STRING,
+    JSON_STATE_ESCAPE,
+    JSON_STATE_UNICODE,
+    JSON_STATE_LITERAL,
+    JSON_STATE_ERROR,
+} VFRJsonState;
+
+struct _VFRJsonReader {
+    vfr_json_reader_cb callback;
+    gpointer data;
+
+    VFRJsonState state;
+    GString *containers;
+    GString *token;
+    GString *key;
+    gboolean has_key;
+    gboolean expect_key;
+    gboolean done;
+
+    gunichar unicode;
+    gunichar surrogate;
+    guint hex_digits;
+};
+
+VFRJsonReader *vfr_json_reader_new(vfr_json_reader_cb callback, gpointer data)
+{
+    VFRJsonReader *self = g_malloc0(sizeof(VFRJsonReader));
+
+    self->callback = callback;
+    self->data = data;
+    self->containers = g_string_new(NULL);
+    self->token = g_string_new(NULL);
+    self->key = g_string_new(NULL);
+
+    return self;
+}
+
+void vfr_json_reader_free(VFRJsonReader *self)
+{
+    if (!self)
+        return;
+
+    g_string_free(self->containers, TRUE);
+    g_string_free(self->token, TRUE);
+    g_string_free(self->key, TRUE);
+    g_free(self);
+}
+
+static gboolean json_in_object(VFRJsonReader *self)
+{
+    return self->containers->len > 0 &&
+           self->containers->str[self->containers->len - 1] == '{';
+}
+
+static void json_emit(VFRJsonReader *self, VFRJsonEvent event, const gchar *value)
+{
+    const gchar *key = NULL;
+
+    if (json_in_object(self) && self->has_key)
+        key = self->key->str;
+
+    self->callback(event, self->containers->len, key, value, self->data);
+    self->has_key = FALSE;
+}
+
+static void json_end_literal(VFRJsonReader *self)
+{
+    if (self->state != JSON_STATE_LITERAL)
+        return;
+
+    self->state = JSON_STATE_DEFAULT;
+    json_emit(self, VFR_JSON_LITERAL, self->token->str);
+}
+
+static void json_end_string(VFRJsonReader *self)
+{
+    self->state = JSON_STATE_DEFAULT;
+
+    if (json_in_object(self) && self->expect_key) {
+        g_string_assign(self->key, self->token->str);
+        self->has_key = TRUE;
+        self->expect_key = FALSE;
+    } else {
+        json_emit(self, VFR_JSON_STRING, self->token->str);
+    }
+}
+
+static void json_open(VFRJsonReader *self, gchar type)
+{
+    json_emit(self, type == '{' ? VFR_JSON_OBJECT_START : VFR_JSON_ARRAY_START, NULL);
+    g_string_append_c(self->containers, type);
+    self->expect_key = type == '{';
+}
+
+static gboolean json_close(VFRJsonReader *self, gchar type)
+{
+    if (self->containers->len == 0 ||
+        self->containers->str[self->containers->len - 1] != type) {
+        return FALSE;
+    }
+
+    g_string_truncate(self->containers, self->containers->len - 1);
+    self->has_key = FALSE;
+    self->expect_key = FALSE;
+    json_emit(self, type == '{' ? VFR_JSON_OBJECT_END : VFR_JSON_ARRAY_END, NULL);
+    if (self->containers->len == 0)
+        self->done = TRUE;
+
+    return TRUE;
+}
+
+static gboolean json_unicode_char(VFRJsonReader *self)
+{
+    gunichar c = self->unicode;
+
+    if (c >= 0xD800 && c < 0xDC00) {
+        self->surrogate = c;
+        return TRUE;
+    }
+
+    if (c >= 0xDC00 && c < 0xE000) {
+        if (!self->surrogate)
+            return FALSE;
+        c = 0x10000 + ((self->surrogate - 0xD800) << 10) + (c - 0xDC00);
+    } else if (self->surrogate) {
+        return FALSE;
+    }
+
+    self->surrogate = 0;
+    g_string_append_unichar(self->token, c);
+
+    return TRUE;
+}
+
+static gboolean json_feed_string(VFRJsonReader *self, gchar c)
+{
+    static const gchar escapes[] = "\"\"\\\\//b\bf\fn\nr\rt\t";
+
+    switch (self->state) {
+    case JSON_STATE_STRING:
+        if (self->surrogate && c != '\\')
+            return FALSE;
+        if (c == '"')
+            json_end_string(self);
+        else if (c == '\\')
+            self->state = JSON_STATE_ESCAPE;
+        else
+            g_string_append_c(self->token, c);
+        break;
+    case JSON_STATE_ESCAPE:
+        self->state = JSON_STATE_STRING;
+        if (c == 'u') {
+            self->state = JSON_STATE_UNICODE;
+            self->unicode = 0;
+            self->hex_digits = 0;
+            break;
+        }
+        if (self->surrogate)
+            return FALSE;
+        for (guint i = 0; escapes[i]; i += 2) {
+            if (escapes[i] == c) {
+                g_string_append_c(self->token, escapes[i + 1]);
+                return TRUE;
+            }
+        }
+        return FALSE;
+    case JSON_STATE_UNICODE:
+        if (!g_ascii_isxdigit(c))
+            return FALSE;
+        self->unicode = (self->unicode << 4) | g_ascii_xdigit_value(c);
+        if (++self->hex_digits == 4) {
+            self->state = JSON_STATE_STRING;
+            return json_unicode_char(self);
+        }
+        break;
+    default:
+        break;
+    }
+
+    return TRUE;
+}
+
+static gboolean json_feed_char(VFRJsonReader *self, gchar c)
+{
+    if (self->state != JSON_STATE_DEFAULT && self->state != JSON_STATE_LITERAL)
+        return json_feed_string(self, c);
+
+    switch (c) {
+    case ' ':
+    case '\t':
+    case '\r':
+    case '\n':
+        json_end_literal(self);
+        break;
+    case '{':
+    case '[':
+        json_end_literal(self);
+        json_open(self, c);
+        break;
+    case '}':
+        json_end_literal(self);
+        return json_close(self, '{');
+    case ']':
+        json_end_literal(self);
+        return json_close(self, '[');
+    case ',':
+        json_end_literal(self);
+        self->expect_key = json_in_object(self);
+        break;
+    case ':':
+        json_end_literal(self);
+        break;
+    case '"':
+        json_end_literal(self);
+        g_string_truncate(self->token, 0);
+        self->state = JSON_STATE_STRING;
+        break;
+    default:
+        if (self->state != JSON_STATE_LITERAL) {
+            g_string_truncate(self->token, 0);
+            self->state = JSON_STATE_LITERAL;
+        }
+        g_string_append_c(self->token, c);
+        break;
+    }
+
+    return TRUE;
+}
+
+// Returns FALSE as soon as the document is found to be malformed
+gboolean vfr_json_reader_feed(VFRJsonReader *self, const gchar *data, gsize len)
+{
+    if (!self || self->state == JSON_STATE_ERROR)
+        return FALSE;
+
+    for (gsize i = 0; i < len; i++) {
+        if (!json_feed_char(self, data[i])) {
+            self->state = JSON_STATE_ERROR;
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+// Whether a complete document was read
+gboolean vfr_json_reader_end(VFRJsonReader *self)
+{
+    if (!self)
+        return FALSE;
+
+    return self->done && self->containers->len == 0 && self->state == JSON_STATE_DEFAULT;
+}
@@ -0,0 +1,37 @@
+/*
+ * (C) Copyright 2019, Arnaud Ferraris <arnaud.ferraris@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ */
+
+#ifndef _VFR_JSON_READER_H
+#define _VFR_JSON_READER_H
+
+#include <glib.h>
+
+typedef enum {
+    VFR_JSON_OBJECT_START = 0,
+    VFR_JSON_OBJECT_END,
+    VFR_JSON_ARRAY_START,
+    VFR_JSON_ARRAY_END,
+    VFR_JSON_STRING,
+    VFR_JSON_LITERAL,
+} VFRJsonEvent;
+
+typedef struct _VFRJsonReader VFRJsonReader;
+
+/*
+ * `depth` is the number of containers enclosing the value, `key` its member
+ * name when the enclosing container is an object (NULL otherwise). `value`
+ * is only set for strings and literals (numbers, true, false and null).
+ */
+typedef void (*vfr_json_reader_cb)(VFRJsonEvent event, guint depth, const gchar *key,
+                                   const gchar *value, gpointer data);
+
+VFRJsonReader *vfr_json_reader_new(vfr_json_reader_cb callback, gpointer data);
+void vfr_json_reader_free(VFRJsonReader *self);
+
+gboolean vfr_json_reader_feed(VFRJsonReader *self, const gchar *data, gsize len);
+gboolean vfr_json_reader_end(VFRJsonReader *self);
+
+#endif /* _VFR_JSON_READER_H */
@@ -6,12 +6,16 @@
 
 #include "librevfr.h"
 
-#include "aircraft.h"
-#include "flight.h"
+#include "loader.h"
 
 #include "nav.h"
 #include "docs.h"
+#include "provider.h"
+#include "sync.h"
 #include "tools.h"
+#include "utils.h"
+
+#include <curl/curl.h>
 
 struct _VFRMainWindow
 {
@@ -32,6 +36,10 @@ struct _VFRMainWindow
     VFRPrepPage *prep;
     VFRNavPage *nav;
     VFRDocsPage *docs;
+
+    // Background syncs, see vfr_main_window_sync_providers()
+    GCancellable *cancellable;
+    guint airac_source;
 };
 
 G_DEFINE_TYPE (VFRMainWindow, vfr_main_window, GTK_TYPE_APPLICATION_WINDOW)
@@ -45,12 +53,176 @@ static void vfr_main_window_back_clicked_cb (GtkWidget *sender, VFRMainWindow *s
 {
     const char *visible = gtk_stack_get_visible_child_name(GTK_STACK(self->main_stack));
 
-    if (g_str_equal(visible, "docs-page"))
-        vfr_docs_page_back(self->docs);
-    else if (g_str_equal(visible, "prep-page"))
-        vfr_prep_page_back(self->prep);
-    else
+    // Pages are only built once they were shown, see vfr_main_window_show_page()
+    if (g_str_equal(visible, "docs-page")) {
+        if (self->docs)
+            vfr_docs_page_back(self->docs);
+    } else if (g_str_equal(visible, "prep-page")) {
+        if (self->prep)
+            vfr_prep_page_back(self->prep);
+    } else if (self->nav) {
         vfr_nav_page_back(self->nav);
+    }
+}
+
+// Data each page needs, as a combination of VFR_LOADER_MASK()
+static guint vfr_main_window_get_page_loaders(VFRMainWindow *self, GtkWidget *page)
+{
+    if (page == self->prep_page)
+        return VFR_LOADER_MASK(VFR_LOADER_AIRCRAFT);
+    else if (page == self->nav_page)
+        return VFR_LOADER_MASK(VFR_LOADER_AIRCRAFT) | VFR_LOADER_MASK(VFR_LOADER_FLIGHTS);
+    else
+        return VFR_LOADER_MASK(VFR_LOADER_PROVIDERS);
+}
+
+static gboolean vfr_main_window_is_page_built(VFRMainWindow *self, GtkWidget *page)
+{
+    if (page == self->prep_page)
+        return self->prep != NULL;
+    else if (page == self->nav_page)
+        return self->nav != NULL;
+    else
+        return self->docs != NULL;
+}
+
+static void vfr_main_window_build_page(VFRMainWindow *self, GtkWidget *page)
+{
+    GtkWidget *spinner = gtk_stack_get_child_by_name(GTK_STACK(page), "loading");
+
+    if (vfr_main_window_is_page_built(self, page))
+        return;
+
+    if (page == self->prep_page)
+        self->prep = vfr_prep_page_new(page, self->header_stack);
+    else if (page == self->nav_page)
+        self->nav = vfr_nav_page_new(page, self->header_stack);
+    else
+        self->docs = vfr_docs_page_new(page, self->header_stack);
+
+    gtk_widget_show_all(page);
+
+    // The page's first screen becomes visible in place of the spinner
+    if (spinner)
+        gtk_widget_destroy(spinner);
+}
+
+static void vfr_main_window_page_ready_cb(GObject *source, GAsyncResult *result, gpointer data)
+{
+    GtkWidget *page = data;
+    GtkWidget *window = gtk_widget_get_toplevel(page);
+
+    // The window may have been closed while the data was loading
+    if (VFR_IS_MAIN_WINDOW(window) && !gtk_widget_in_destruction(window))
+        vfr_main_window_build_page(VFR_MAIN_WINDOW(window), page);
+
+    g_object_unref(page);
+}
+
+/*
+ * Pages are built when they are first shown rather than with the window, so
+ * that only the one in use takes time and memory. If its data isn't loaded
+ * yet, a spinner is displayed until it is.
+ */
+static void vfr_main_window_show_page(VFRMainWindow *self, GtkWidget *page)
+{
+    GtkWidget *spinner;
+    guint loaders;
+
+    if (!page || vfr_main_window_is_page_built(self, page) ||
+        gtk_stack_get_child_by_name(GTK_STACK(page), "loading"))
+        return;
+
+    loaders = vfr_main_window_get_page_loaders(self, page);
+    if (vfr_loader_is_done(loaders)) {
+        vfr_main_window_build_page(self, page);
+        return;
+    }
+
+    spinner = gtk_spinner_new();
+    gtk_spinner_start(GTK_SPINNER(spinner));
+    gtk_stack_add_named(GTK_STACK(page), spinner, "loading");
+    gtk_widget_show(spinner);
+
+    vfr_loader_wait_async(loaders, vfr_main_window_page_ready_cb, g_object_ref(page));
+}
+
+static void vfr_main_window_visible_child_cb(GObject *object, GParamSpec *spec,
+                                             VFRMainWindow *self)
+{
+    vfr_main_window_show_page(self, gtk_stack_get_visible_child(GTK_STACK(object)));
+}
+
+static void vfr_main_window_sync_progress_cb(VFRProvider *provider, guint done, guint total,
+                                             gpointer data)
+{
+    VFRMainWindow *self = data;
+
+    // The cancellable is gone once the window was destroyed
+    if (self->docs && self->cancellable)
+        vfr_docs_page_sync_progress(self->docs, provider, done, total);
+}
+
+static void vfr_main_window_synced_cb(VFRProvider *provider, gboolean updated, gpointer data)
+{
+    VFRMainWindow *self = data;
+
+    // Otherwise, the page will use the new terrains once it is built
+    if (self->docs && self->cancellable)
+        vfr_docs_page_synced(self->docs, provider, updated);
+
+    g_object_unref(self);
+}
+
+static gboolean vfr_main_window_airac_cb(gpointer data);
+
+/*
+ * Cached charts are already usable, refresh them in the background whichever
+ * page is in use. Syncs are run again when the next AIRAC cycle becomes
+ * effective, so that its (already staged) charts are activated without
+ * restarting the app. Each running sync holds a reference on the window,
+ * and they are all cancelled when it is destroyed.
+ */
+static void vfr_main_window_sync_providers(VFRMainWindow *self)
+{
+    GPtrArray *providers = vfr_provider_get_all();
+    time_t next = vfr_get_airac_date(VFR_AIRAC_NEXT);
+
+    for (guint i = 0; i < providers->len; i++) {
+        if (vfr_provider_is_syncing(providers->pdata[i]))
+            continue;
+
+        vfr_provider_sync_async(providers->pdata[i], self->cancellable,
+                                vfr_main_window_sync_progress_cb, vfr_main_window_synced_cb,
+                                g_object_ref(self));
+    }
+
+    if (self->airac_source == 0) {
+        self->airac_source = g_timeout_add_seconds(MAX(next - time(NULL), 0) + 60,
+                                                   vfr_main_window_airac_cb, self);
+    }
+}
+
+static gboolean vfr_main_window_airac_cb(gpointer data)
+{
+    VFRMainWindow *self = data;
+
+    self->airac_source = 0;
+    vfr_main_window_sync_providers(self);
+
+    return G_SOURCE_REMOVE;
+}
+
+static void vfr_main_window_providers_ready_cb(GObject *source, GAsyncResult *result,
+                                               gpointer data)
+{
+    VFRMainWindow *self = data;
+
+    // The window may have been closed while the providers were loading
+    if (self->cancellable && !g_cancellable_is_cancelled(self->cancellable))
+        vfr_main_window_sync_providers(self);
+
+    g_object_unref(self);
 }
 
 static void show_window (GtkApplication *app)
@@ -68,9 +240,28 @@ static void vfr_main_window_constructed (GObject *object)
 
     G_OBJECT_CLASS (vfr_main_window_parent_class)->constructed (object);
 
-    self->prep = vfr_prep_page_new(self->prep_page, self->header_stack);
-    self->nav = vfr_nav_page_new(self->nav_page, self->header_stack);
-    self->docs = vfr_docs_page_new(self->docs_page, self->header_stack);
+    g_signal_connect(self->main_stack, "notify::visible-child",
+                     G_CALLBACK(vfr_main_window_visible_child_cb), self);
+    vfr_main_window_show_page(self, gtk_stack_get_visible_child(GTK_STACK(self->main_stack)));
+
+    vfr_loader_wait_async(VFR_LOADER_MASK(VFR_LOADER_PROVIDERS),
+                          vfr_main_window_providers_ready_cb, g_object_ref(self));
+}
+
+static void vfr_main_window_dispose(GObject *object)
+{
+    VFRMainWindow *self = VFR_MAIN_WINDOW(object);
+
+    if (self->cancellable)
+        g_cancellable_cancel(self->cancellable);
+    g_clear_object(&self->cancellable);
+
+    if (self->airac_source) {
+        g_source_remove(self->airac_source);
+        self->airac_source = 0;
+    }
+
+    G_OBJECT_CLASS(vfr_main_window_parent_class)->dispose(object);
 }
 
 static void vfr_main_window_class_init(VFRMainWindowClass *klass)
@@ -79,6 +270,7 @@ static void vfr_main_window_class_init(VFRMainWindowClass *klass)
     GtkWidgetClass *widget_class = GTK_WIDGET_CLASS (klass);
 
     object_class->constructed = vfr_main_window_constructed;
+    object_class->dispose = vfr_main_window_dispose;
 
     gtk_widget_class_set_template_from_resource (widget_class, "/com/a-wai/librevfr/ui/librevfr.ui");
     gtk_widget_class_bind_template_child (widget_class, VFRMainWindow, header_stack);
@@ -96,6 +288,8 @@ static void vfr_main_window_class_init(VFRMainWindowClass *klass)
 static void vfr_main_window_init(VFRMainWindow *self)
 {
     gtk_widget_init_template (GTK_WIDGET (self));
+
+    self->cancellable = g_cancellable_new();
 }
 
 int main (int argc, char *argv[])
@@ -103,9 +297,16 @@ int main (int argc, char *argv[])
     GtkApplication *app;
     int status;
 
+    if (argc > 1 && g_str_equal(argv[1], "--sync"))
+        return vfr_sync_main(argc, argv);
+
+    // Not thread-safe, so done before the loaders start
+    curl_global_init(CURL_GLOBAL_DEFAULT);
+
+    // Load data while GTK is initialised and the window built
+    vfr_loader_start();
     hdy_init(&argc, &argv);
-    vfr_aircraft_init();
-    vfr_flight_init();
+    ev_init();
 
     app = gtk_application_new("com.a-wai.LibreVFR", G_APPLICATION_FLAGS_NONE);
 
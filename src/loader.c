@@ -0,0 +1,132 @@
+/*
+ * (C) Copyright 2019, Arnaud Ferraris <arnaud.ferraris@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ */
+
+#include "loader.h"
+
+#include "aircraft.h"
+#include "flight.h"
+#include "provider.h"
+
+/*
+ * Data needed by the UI (aircraft, flights and terrains lists) is loaded
+ * concurrently at startup, while the window is being built. Each loader is
+ * only waited for when its data is first used; if it hasn't been picked by
+ * a worker thread yet, it is run right away by the thread needing it.
+ * Loaders are run at most once, even if vfr_loader_start() isn't called.
+ */
+
+enum {
+    LOADER_IDLE = 0,
+    LOADER_RUNNING,
+    LOADER_DONE
+};
+
+static gboolean loader_load_providers(void)
+{
+    return vfr_provider_init() != NULL;
+}
+
+static gboolean (*loader_funcs[VFR_LOADER_COUNT])(void) = {
+    [VFR_LOADER_AIRCRAFT] = vfr_aircraft_init,
+    [VFR_LOADER_FLIGHTS] = vfr_flight_init,
+    [VFR_LOADER_PROVIDERS] = loader_load_providers,
+};
+
+static gint loader_state[VFR_LOADER_COUNT];
+static GMutex loader_lock;
+static GCond loader_cond;
+
+static void loader_run(VFRLoaderId id)
+{
+    g_mutex_lock(&loader_lock);
+    if (g_atomic_int_get(&loader_state[id]) != LOADER_IDLE) {
+        g_mutex_unlock(&loader_lock);
+        return;
+    }
+    g_atomic_int_set(&loader_state[id], LOADER_RUNNING);
+    g_mutex_unlock(&loader_lock);
+
+    loader_funcs[id]();
+
+    g_mutex_lock(&loader_lock);
+    g_atomic_int_set(&loader_state[id], LOADER_DONE);
+    g_cond_broadcast(&loader_cond);
+    g_mutex_unlock(&loader_lock);
+}
+
+static void loader_thread(gpointer data, gpointer user_data)
+{
+    loader_run(GPOINTER_TO_INT(data) - 1);
+}
+
+// Start all loaders in the background, on as many threads as there are cores
+void vfr_loader_start(void)
+{
+    guint threads = MIN(g_get_num_processors(), VFR_LOADER_COUNT);
+    GThreadPool *pool;
+
+    pool = g_thread_pool_new(loader_thread, NULL, threads, FALSE, NULL);
+    if (!pool)
+        return;
+
+    for (gint i = 0; i < VFR_LOADER_COUNT; i++)
+        g_thread_pool_push(pool, GINT_TO_POINTER(i + 1), NULL);
+
+    // The pool is freed once all loaders completed
+    g_thread_pool_free(pool, FALSE, FALSE);
+}
+
+// Block until the data of a loader is available
+void vfr_loader_wait(VFRLoaderId id)
+{
+    if (id >= VFR_LOADER_COUNT || g_atomic_int_get(&loader_state[id]) == LOADER_DONE)
+        return;
+
+    loader_run(id);
+
+    g_mutex_lock(&loader_lock);
+    while (g_atomic_int_get(&loader_state[id]) != LOADER_DONE)
+        g_cond_wait(&loader_cond, &loader_lock);
+    g_mutex_unlock(&loader_lock);
+}
+
+// Whether all loaders of a VFR_LOADER_MASK() combination completed
+gboolean vfr_loader_is_done(guint loaders)
+{
+    for (gint i = 0; i < VFR_LOADER_COUNT; i++) {
+        if ((loaders & VFR_LOADER_MASK(i)) &&
+            g_atomic_int_get(&loader_state[i]) != LOADER_DONE)
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
+static void loader_wait_thread(GTask *task, gpointer source, gpointer task_data,
+                               GCancellable *cancellable)
+{
+    guint loaders = GPOINTER_TO_UINT(task_data);
+
+    for (gint i = 0; i < VFR_LOADER_COUNT; i++) {
+        if (loaders & VFR_LOADER_MASK(i))
+            vfr_loader_wait(i);
+    }
+
+    g_task_return_boolean(task, TRUE);
+}
+
+/*
+ * Wait for several loaders without blocking the calling thread: `callback`
+ * is called from the thread-default main context once they all completed.
+ */
+void vfr_loader_wait_async(guint loaders, GAsyncReadyCallback callback, gpointer data)
+{
+    GTask *task = g_task_new(NULL, NULL, callback, data);
+
+    g_task_set_task_data(task, GUINT_TO_POINTER(loaders), NULL);
+    g_task_run_in_thread(task, loader_wait_thread);
+    g_object_unref(task);
+}
@@ -0,0 +1,26 @@
+/*
+ * (C) Copyright 2019, Arnaud Ferraris <arnaud.ferraris@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ */
+
+#ifndef _VFR_LOADER_H
+#define _VFR_LOADER_H
+
+#include <gio/gio.h>
+
+typedef enum {
+    VFR_LOADER_AIRCRAFT = 0,
+    VFR_LOADER_FLIGHTS,
+    VFR_LOADER_PROVIDERS,
+    VFR_LOADER_COUNT
+} VFRLoaderId;
+
+#define VFR_LOADER_MASK(id) (1 << (id))
+
+void vfr_loader_start(void);
+void vfr_loader_wait(VFRLoaderId id);
+gboolean vfr_loader_is_done(guint loaders);
+void vfr_loader_wait_async(guint loaders, GAsyncReadyCallback callback, gpointer data);
+
+#endif /* _VFR_LOADER_H */
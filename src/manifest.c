@@ -0,0 +1,133 @@
+/*
+ * (C) Copyright 2019, Arnaud Ferraris <arnaud.ferraris@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ */
+
+#include "manifest.h"
+
+/*
+ * The manifest is a text file with one line per downloaded file:
+ *   <key>\t<size>\t<sha256>\t<etag>\t<last-modified>
+ * Tabs can't appear in HTTP header values, so no escaping is needed.
+ */
+
+struct _VFRManifest {
+    GString *filename;
+    GHashTable *entries;
+    gboolean dirty;
+};
+
+static void manifest_entry_free(VFRManifestEntry *entry)
+{
+    g_string_free(entry->etag, TRUE);
+    g_string_free(entry->last_modified, TRUE);
+    g_string_free(entry->hash, TRUE);
+    g_free(entry);
+}
+
+VFRManifest *vfr_manifest_load(const gchar *filename)
+{
+    VFRManifest *self = g_malloc0(sizeof(VFRManifest));
+    gchar *contents = NULL;
+    gchar **lines;
+
+    self->filename = g_string_new(filename);
+    self->entries = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                          (GDestroyNotify)manifest_entry_free);
+
+    if (!g_file_get_contents(filename, &contents, NULL, NULL))
+        return self;
+
+    lines = g_strsplit(contents, "\n", 0);
+    for (guint i = 0; lines[i]; i++) {
+        gchar **fields = g_strsplit(lines[i], "\t", 5);
+
+        if (g_strv_length(fields) == 5) {
+            vfr_manifest_update(self, fields[0], fields[3], fields[4], fields[2],
+                                g_ascii_strtoll(fields[1], NULL, 10));
+        }
+        g_strfreev(fields);
+    }
+    g_strfreev(lines);
+    g_free(contents);
+
+    self->dirty = FALSE;
+
+    return self;
+}
+
+gboolean vfr_manifest_save(VFRManifest *self)
+{
+    GString *contents;
+    GHashTableIter iter;
+    gpointer key, value;
+    gboolean result;
+
+    if (!self)
+        return FALSE;
+
+    if (!self->dirty)
+        return TRUE;
+
+    contents = g_string_new(NULL);
+    g_hash_table_iter_init(&iter, self->entries);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        VFRManifestEntry *entry = value;
+
+        g_string_append_printf(contents, "%s\t%" G_GOFFSET_FORMAT "\t%s\t%s\t%s\n",
+                               (const gchar *)key, entry->size, entry->hash->str,
+                               entry->etag->str, entry->last_modified->str);
+    }
+
+    // g_file_set_contents() writes to a temporary file and renames it
+    result = g_file_set_contents(self->filename->str, contents->str, contents->len, NULL);
+    if (result)
+        self->dirty = FALSE;
+
+    g_string_free(contents, TRUE);
+
+    return result;
+}
+
+void vfr_manifest_free(VFRManifest *self)
+{
+    if (!self)
+        return;
+
+    g_hash_table_destroy(self->entries);
+    g_string_free(self->filename, TRUE);
+    g_free(self);
+}
+
+VFRManifestEntry *vfr_manifest_lookup(VFRManifest *self, const gchar *key)
+{
+    if (self && key)
+        return g_hash_table_lookup(self->entries, key);
+
+    return NULL;
+}
+
+void vfr_manifest_update(VFRManifest *self, const gchar *key, const gchar *etag,
+                         const gchar *last_modified, const gchar *hash, goffset size)
+{
+    VFRManifestEntry *entry;
+
+    if (!self || !key)
+        return;
+
+    entry = g_malloc0(sizeof(VFRManifestEntry));
+    entry->etag = g_string_new(etag);
+    entry->last_modified = g_string_new(last_modified);
+    entry->hash = g_string_new(hash);
+    entry->size = size;
+
+    g_hash_table_replace(self->entries, g_strdup(key), entry);
+    self->dirty = TRUE;
+}
+
+void vfr_manifest_remove(VFRManifest *self, const gchar *key)
+{
+    if (self && key && g_hash_table_remove(self->entries, key))
+        self->dirty = TRUE;
+}
@@ -0,0 +1,30 @@
+/*
+ * (C) Copyright 2019, Arnaud Ferraris <arnaud.ferraris@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ */
+
+#ifndef _VFR_MANIFEST_H
+#define _VFR_MANIFEST_H
+
+#include <glib.h>
+
+typedef struct _VFRManifest VFRManifest;
+
+typedef struct {
+    GString *etag;
+    GString *last_modified;
+    GString *hash;
+    goffset size;
+} VFRManifestEntry;
+
+VFRManifest *vfr_manifest_load(const gchar *filename);
+gboolean vfr_manifest_save(VFRManifest *self);
+void vfr_manifest_free(VFRManifest *self);
+
+VFRManifestEntry *vfr_manifest_lookup(VFRManifest *self, const gchar *key);
+void vfr_manifest_update(VFRManifest *self, const gchar *key, const gchar *etag,
+                         const gchar *last_modified, const gchar *hash, goffset size);
+void vfr_manifest_remove(VFRManifest *self, const gchar *key);
+
+#endif /* _VFR_MANIFEST_H */
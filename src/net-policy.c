@@ -0,0 +1,154 @@
+/*
+ * (C) Copyright 2019, Arnaud Ferraris <arnaud.ferraris@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ */
+
+#include "net-policy.h"
+
+#include <stdio.h>
+#include <string.h>
+
+/*
+ * Requests to a host which keeps failing are refused for a while (circuit
+ * breaker), rather than each waiting for its own timeout. Once the cooldown
+ * is over, a single request is let through: the host is available again if
+ * it succeeds, otherwise it's refused for another cooldown period.
+ */
+typedef struct {
+    guint failures;
+    gint64 open_until;
+} VFRNetHost;
+
+static GMutex host_lock;
+static GHashTable *hosts = NULL;
+
+// Requests are made from worker threads, where curl can't use signals
+void vfr_net_policy_apply(CURL *curl)
+{
+    curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, (long)VFR_NET_CONNECT_TIMEOUT);
+
+    // Abort stalled transfers, without limiting the duration of slow ones
+    curl_easy_setopt(curl, CURLOPT_LOW_SPEED_LIMIT, (long)VFR_NET_LOW_SPEED_LIMIT);
+    curl_easy_setopt(curl, CURLOPT_LOW_SPEED_TIME, (long)VFR_NET_LOW_SPEED_TIME);
+}
+
+// Whether a request that failed this way may succeed if tried again
+gboolean vfr_net_is_transient(CURLcode result, glong status)
+{
+    switch (result) {
+    case CURLE_OK:
+        break;
+    case CURLE_COULDNT_RESOLVE_HOST:
+    case CURLE_COULDNT_CONNECT:
+    case CURLE_OPERATION_TIMEDOUT:
+    case CURLE_SEND_ERROR:
+    case CURLE_RECV_ERROR:
+    case CURLE_GOT_NOTHING:
+    case CURLE_PARTIAL_FILE:
+    case CURLE_HTTP2:
+    case CURLE_HTTP2_STREAM:
+    case CURLE_SSL_CONNECT_ERROR:
+        return TRUE;
+    default:
+        return FALSE;
+    }
+
+    return status == 408 || status == 429 || status == 500 ||
+           status == 502 || status == 503 || status == 504;
+}
+
+/*
+ * Exponential backoff with jitter: the delay before retry N is picked
+ * between half and all of BASE * 2^N, so that parallel transfers which
+ * failed together don't all retry at the same time.
+ */
+gint64 vfr_net_get_backoff(guint attempt)
+{
+    gint64 delay = VFR_NET_BACKOFF_BASE << MIN(attempt, 16);
+
+    delay = MIN(delay, VFR_NET_BACKOFF_MAX);
+
+    return delay / 2 + (gint64)(g_random_double() * (delay / 2));
+}
+
+// "scheme://user@host:port/path" -> "host:port"
+static gchar *net_get_host(const gchar *url)
+{
+    const gchar *start = strstr(url, "://");
+    const gchar *end;
+    const gchar *at;
+
+    start = start ? start + 3 : url;
+    end = start + strcspn(start, "/?#");
+
+    at = g_strstr_len(start, end - start, "@");
+    if (at)
+        start = at + 1;
+
+    return g_ascii_strdown(start, end - start);
+}
+
+gboolean vfr_net_host_allowed(const gchar *url)
+{
+    gchar *name;
+    VFRNetHost *host = NULL;
+    gboolean allowed = TRUE;
+    gint64 now = g_get_monotonic_time();
+
+    if (!url)
+        return FALSE;
+
+    name = net_get_host(url);
+
+    g_mutex_lock(&host_lock);
+    if (hosts)
+        host = g_hash_table_lookup(hosts, name);
+
+    if (host && host->failures >= VFR_NET_BREAKER_THRESHOLD) {
+        if (now >= host->open_until)
+            host->open_until = now + VFR_NET_BREAKER_COOLDOWN;
+        else
+            allowed = FALSE;
+    }
+    g_mutex_unlock(&host_lock);
+
+    g_free(name);
+
+    return allowed;
+}
+
+void vfr_net_host_report(const gchar *url, CURLcode result, glong status)
+{
+    gchar *name;
+    VFRNetHost *host;
+
+    // Requests aborted on our side tell nothing about the host
+    if (!url || result == CURLE_ABORTED_BY_CALLBACK || result == CURLE_WRITE_ERROR)
+        return;
+
+    name = net_get_host(url);
+
+    g_mutex_lock(&host_lock);
+    if (!hosts)
+        hosts = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+
+    host = g_hash_table_lookup(hosts, name);
+    if (!host) {
+        host = g_malloc0(sizeof(VFRNetHost));
+        g_hash_table_insert(hosts, g_strdup(name), host);
+    }
+
+    if (!vfr_net_is_transient(result, status)) {
+        host->failures = 0;
+        host->open_until = 0;
+    } else if (++host->failures >= VFR_NET_BREAKER_THRESHOLD) {
+        if (host->failures == VFR_NET_BREAKER_THRESHOLD)
+            printf("%s: too many failures, pausing requests\n", name);
+        host->open_until = g_get_monotonic_time() + VFR_NET_BREAKER_COOLDOWN;
+    }
+    g_mutex_unlock(&host_lock);
+
+    g_free(name);
+}
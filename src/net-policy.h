@@ -0,0 +1,33 @@
+/*
+ * (C) Copyright 2019, Arnaud Ferraris <arnaud.ferraris@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ */
+
+#ifndef _VFR_NET_POLICY_H
+#define _VFR_NET_POLICY_H
+
+#include <glib.h>
+
+#include <curl/curl.h>
+
+#define VFR_NET_CONNECT_TIMEOUT 15
+#define VFR_NET_LOW_SPEED_LIMIT 1024
+#define VFR_NET_LOW_SPEED_TIME 30
+
+#define VFR_NET_MAX_RETRIES 3
+#define VFR_NET_BACKOFF_BASE (500 * G_TIME_SPAN_MILLISECOND)
+#define VFR_NET_BACKOFF_MAX (16 * G_TIME_SPAN_SECOND)
+
+#define VFR_NET_BREAKER_THRESHOLD 5
+#define VFR_NET_BREAKER_COOLDOWN (30 * G_TIME_SPAN_SECOND)
+
+void vfr_net_policy_apply(CURL *curl);
+
+gboolean vfr_net_is_transient(CURLcode result, glong status);
+gint64 vfr_net_get_backoff(guint attempt);
+
+gboolean vfr_net_host_allowed(const gchar *url);
+void vfr_net_host_report(const gchar *url, CURLcode result, glong status);
+
+#endif /* _VFR_NET_POLICY_H */
@@ -0,0 +1,179 @@
+/*
+ * (C) Copyright 2019, Arnaud Ferraris <arnaud.ferraris@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ */
+
+#include "net-stats.h"
+
+#include <string.h>
+
+#include <glib/gstdio.h>
+
+/*
+ * Every request made for a provider is timed, and aggregated per provider
+ * for the whole session. When the LIBREVFR_NET_LOG environment variable is
+ * set, each request is also appended to the file it names, as one JSON
+ * object per line.
+ */
+
+static GMutex net_lock;
+static GHashTable *net_stats = NULL;
+static FILE *net_log = NULL;
+static gboolean net_log_opened = FALSE;
+
+static gdouble net_get_time(CURL *curl, CURLINFO info)
+{
+    curl_off_t value = 0;
+
+    curl_easy_getinfo(curl, info, &value);
+
+    return value / (gdouble)G_USEC_PER_SEC;
+}
+
+/*
+ * curl reports the time elapsed from the start of the request to the end
+ * of each phase. Phases that didn't happen (e.g. on a reused connection)
+ * are reported as 0 and count as such.
+ */
+void vfr_net_timing_init(VFRNetTiming *timing, CURL *curl, CURLcode result)
+{
+    gdouble dns = net_get_time(curl, CURLINFO_NAMELOOKUP_TIME_T);
+    gdouble connect = net_get_time(curl, CURLINFO_CONNECT_TIME_T);
+    gdouble tls = net_get_time(curl, CURLINFO_APPCONNECT_TIME_T);
+    gdouble start = net_get_time(curl, CURLINFO_STARTTRANSFER_TIME_T);
+    gdouble total = net_get_time(curl, CURLINFO_TOTAL_TIME_T);
+    gdouble ready;
+    curl_off_t size = 0;
+
+    memset(timing, 0, sizeof(VFRNetTiming));
+    ready = MAX(MAX(dns, connect), tls);
+
+    timing->dns = dns;
+    timing->connect = connect > dns ? connect - dns : 0;
+    timing->tls = tls > connect ? tls - connect : 0;
+    timing->ttfb = start > ready ? start - ready : 0;
+    timing->transfer = total > start && start > 0 ? total - start : 0;
+    timing->total = total;
+    timing->result = result;
+
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &timing->status);
+    curl_easy_getinfo(curl, CURLINFO_SIZE_DOWNLOAD_T, &size);
+    timing->size = size;
+}
+
+static gboolean net_is_failure(const VFRNetTiming *timing)
+{
+    return timing->result != CURLE_OK || timing->status >= 400;
+}
+
+void vfr_net_stats_add(VFRNetStats *stats, const VFRNetTiming *timing)
+{
+    if (!stats || !timing)
+        return;
+
+    stats->requests++;
+    if (net_is_failure(timing))
+        stats->failures++;
+    stats->bytes += timing->size;
+    stats->dns += timing->dns;
+    stats->connect += timing->connect;
+    stats->tls += timing->tls;
+    stats->ttfb += timing->ttfb;
+    stats->transfer += timing->transfer;
+    stats->total += timing->total;
+    stats->slowest = MAX(stats->slowest, timing->total);
+}
+
+static void net_log_append_string(GString *line, const gchar *str)
+{
+    g_string_append_c(line, '"');
+    for (const gchar *p = str; *p; p++) {
+        if (*p == '"' || *p == '\\')
+            g_string_append_printf(line, "\\%c", *p);
+        else if ((guchar)*p < 0x20)
+            g_string_append_printf(line, "\\u%04x", *p);
+        else
+            g_string_append_c(line, *p);
+    }
+    g_string_append_c(line, '"');
+}
+
+// Must be called with the lock held
+static void net_log_write(const gchar *provider, const gchar *url, const VFRNetTiming *timing)
+{
+    GString *line;
+
+    if (!net_log_opened) {
+        const gchar *filename = g_getenv("LIBREVFR_NET_LOG");
+
+        if (filename && filename[0])
+            net_log = g_fopen(filename, "a");
+        net_log_opened = TRUE;
+    }
+
+    if (!net_log)
+        return;
+
+    line = g_string_new(NULL);
+    g_string_append_printf(line, "{\"time\":%" G_GINT64_FORMAT ",\"provider\":",
+                           g_get_real_time() / G_USEC_PER_SEC);
+    net_log_append_string(line, provider);
+    g_string_append(line, ",\"url\":");
+    net_log_append_string(line, url);
+    g_string_append_printf(line, ",\"status\":%ld,\"result\":%d,\"size\":%" G_GOFFSET_FORMAT,
+                           timing->status, timing->result, timing->size);
+    g_string_append_printf(line, ",\"dns\":%.6f,\"connect\":%.6f,\"tls\":%.6f"
+                                 ",\"ttfb\":%.6f,\"transfer\":%.6f,\"total\":%.6f}\n",
+                           timing->dns, timing->connect, timing->tls,
+                           timing->ttfb, timing->transfer, timing->total);
+
+    // Lines are written at once, so that they can be followed with `tail -f`
+    fwrite(line->str, 1, line->len, net_log);
+    fflush(net_log);
+    g_string_free(line, TRUE);
+}
+
+void vfr_net_record(const gchar *provider, const gchar *url, const VFRNetTiming *timing)
+{
+    VFRNetStats *stats;
+
+    if (!provider || !url || !timing)
+        return;
+
+    g_mutex_lock(&net_lock);
+
+    if (!net_stats)
+        net_stats = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+
+    stats = g_hash_table_lookup(net_stats, provider);
+    if (!stats) {
+        stats = g_malloc0(sizeof(VFRNetStats));
+        g_hash_table_insert(net_stats, g_strdup(provider), stats);
+    }
+
+    vfr_net_stats_add(stats, timing);
+    net_log_write(provider, url, timing);
+
+    g_mutex_unlock(&net_lock);
+}
+
+// Statistics of all the requests made for a provider since startup
+gboolean vfr_net_get_stats(const gchar *provider, VFRNetStats *stats)
+{
+    VFRNetStats *found = NULL;
+
+    if (!provider || !stats)
+        return FALSE;
+
+    g_mutex_lock(&net_lock);
+    if (net_stats)
+        found = g_hash_table_lookup(net_stats, provider);
+    if (found)
+        *stats = *found;
+    else
+        memset(stats, 0, sizeof(VFRNetStats));
+    g_mutex_unlock(&net_lock);
+
+    return found != NULL;
+}
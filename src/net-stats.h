@@ -0,0 +1,46 @@
+/*
+ * (C) Copyright 2019, Arnaud Ferraris <arnaud.ferraris@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ */
+
+#ifndef _VFR_NET_STATS_H
+#define _VFR_NET_STATS_H
+
+#include <glib.h>
+
+#include <curl/curl.h>
+
+// Durations of each phase of a request, in seconds
+typedef struct {
+    gdouble dns;
+    gdouble connect;
+    gdouble tls;
+    gdouble ttfb;
+    gdouble transfer;
+    gdouble total;
+    goffset size;
+    glong status;
+    CURLcode result;
+} VFRNetTiming;
+
+typedef struct {
+    guint requests;
+    guint failures;
+    goffset bytes;
+    gdouble dns;
+    gdouble connect;
+    gdouble tls;
+    gdouble ttfb;
+    gdouble transfer;
+    gdouble total;
+    gdouble slowest;
+} VFRNetStats;
+
+void vfr_net_timing_init(VFRNetTiming *timing, CURL *curl, CURLcode result);
+void vfr_net_stats_add(VFRNetStats *stats, const VFRNetTiming *timing);
+
+void vfr_net_record(const gchar *provider, const gchar *url, const VFRNetTiming *timing);
+gboolean vfr_net_get_stats(const gchar *provider, VFRNetStats *stats);
+
+#endif /* _VFR_NET_STATS_H */
@@ -0,0 +1,181 @@
+/*
+ * (C) Copyright 2019, Arnaud Ferraris <arnaud.ferraris@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ */
+
+#include "preview.h"
+
+#include <string.h>
+
+#include <evince-document.h>
+#include <glib/gstdio.h>
+
+/*
+ * Previews are PNG renderings of the first page of each chart, stored in
+ * $XDG_DATA_HOME/librevfr/<id>/cache: a small thumbnail for chart lists
+ * and a screen-sized raster displayed while the PDF itself is loading.
+ */
+
+static const gchar *preview_suffixes[] = {
+    "thumb",
+    "page1",
+};
+
+static const gint preview_widths[] = {
+    VFR_PREVIEW_THUMBNAIL_WIDTH,
+    VFR_PREVIEW_PAGE_WIDTH,
+};
+
+GString *vfr_preview_get_filename(VFRProvider *provider, const gchar *icao,
+                                  VFRPreviewType type)
+{
+    GString *filename = g_string_new(g_get_user_data_dir());
+
+    g_string_append_printf(filename, "/librevfr/%s/cache/%s-%s.png",
+                           vfr_provider_get_id(provider), icao, preview_suffixes[type]);
+
+    return filename;
+}
+
+static gboolean preview_is_current(const gchar *chart, const gchar *preview)
+{
+    GStatBuf chart_st;
+    GStatBuf preview_st;
+
+    if (g_stat(chart, &chart_st) < 0 || g_stat(preview, &preview_st) < 0)
+        return FALSE;
+
+    return preview_st.st_mtime >= chart_st.st_mtime;
+}
+
+static gboolean preview_write(EvDocument *document, EvPage *page, gdouble page_width,
+                              gint width, const gchar *filename)
+{
+    EvRenderContext *rc;
+    cairo_surface_t *surface;
+    GString *tmpfile;
+    gboolean result;
+
+    rc = ev_render_context_new(page, 0, width / page_width);
+    ev_document_doc_mutex_lock();
+    ev_document_fc_mutex_lock();
+    surface = ev_document_render(document, rc);
+    ev_document_fc_mutex_unlock();
+    ev_document_doc_mutex_unlock();
+    g_object_unref(rc);
+
+    if (!surface)
+        return FALSE;
+
+    // Write to a temporary file so that readers never see a partial image
+    tmpfile = g_string_new(filename);
+    g_string_append(tmpfile, ".tmp");
+    result = cairo_surface_write_to_png(surface, tmpfile->str) == CAIRO_STATUS_SUCCESS &&
+             g_rename(tmpfile->str, filename) == 0;
+    if (!result)
+        g_remove(tmpfile->str);
+
+    g_string_free(tmpfile, TRUE);
+    cairo_surface_destroy(surface);
+
+    return result;
+}
+
+static gboolean preview_render_chart(VFRProvider *provider, const gchar *chart,
+                                     const gchar *icao)
+{
+    GString *filenames[G_N_ELEMENTS(preview_suffixes)];
+    EvDocument *document = NULL;
+    EvPage *page = NULL;
+    gdouble page_width, page_height;
+    gboolean result = TRUE;
+    gboolean current = TRUE;
+    gchar *uri;
+
+    for (guint i = 0; i < G_N_ELEMENTS(preview_suffixes); i++) {
+        filenames[i] = vfr_preview_get_filename(provider, icao, i);
+        if (!preview_is_current(chart, filenames[i]->str))
+            current = FALSE;
+    }
+
+    if (current)
+        goto out;
+
+    /*
+     * Fontconfig isn't thread-safe: hold the lock evince's own jobs take, as
+     * charts may be loaded for display at the same time.
+     */
+    uri = g_filename_to_uri(chart, NULL, NULL);
+    ev_document_fc_mutex_lock();
+    document = ev_document_factory_get_document(uri, NULL);
+    ev_document_fc_mutex_unlock();
+    g_free(uri);
+    if (!document || ev_document_get_n_pages(document) < 1) {
+        result = FALSE;
+        goto out;
+    }
+
+    ev_document_doc_mutex_lock();
+    page = ev_document_get_page(document, 0);
+    ev_document_get_page_size(document, 0, &page_width, &page_height);
+    ev_document_doc_mutex_unlock();
+
+    for (guint i = 0; i < G_N_ELEMENTS(preview_suffixes) && result; i++)
+        result = preview_write(document, page, page_width, preview_widths[i], filenames[i]->str);
+
+out:
+    for (guint i = 0; i < G_N_ELEMENTS(preview_suffixes); i++)
+        g_string_free(filenames[i], TRUE);
+    if (page)
+        g_object_unref(page);
+    if (document)
+        g_object_unref(document);
+
+    return result;
+}
+
+/*
+ * Render missing or outdated previews for every chart of a provider. This
+ * is meant to run in a worker thread, after the provider was updated.
+ */
+gboolean vfr_preview_render_provider(VFRProvider *provider, GCancellable *cancellable)
+{
+    GString *data_dir = g_string_new(g_get_user_data_dir());
+    GString *cache_dir = g_string_new(g_get_user_data_dir());
+    GString *chart = g_string_new(NULL);
+    const gchar *current_file;
+    gboolean result = TRUE;
+    GDir *dir;
+
+    g_string_append_printf(data_dir, "/librevfr/%s/files", vfr_provider_get_id(provider));
+    g_string_append_printf(cache_dir, "/librevfr/%s/cache", vfr_provider_get_id(provider));
+    g_mkdir_with_parents(cache_dir->str, 0755);
+
+    dir = g_dir_open(data_dir->str, 0, NULL);
+    while (dir && (current_file = g_dir_read_name(dir)) != NULL) {
+        gchar *icao;
+
+        if (g_cancellable_is_cancelled(cancellable)) {
+            result = FALSE;
+            break;
+        }
+
+        if (!g_str_has_suffix(current_file, ".pdf"))
+            continue;
+
+        g_string_printf(chart, "%s/%s", data_dir->str, current_file);
+        icao = g_strndup(current_file, strlen(current_file) - strlen(".pdf"));
+        if (!preview_render_chart(provider, chart->str, icao))
+            printf("%s: unable to render preview for %s\n", vfr_provider_get_id(provider), icao);
+        g_free(icao);
+    }
+
+    if (dir)
+        g_dir_close(dir);
+    g_string_free(chart, TRUE);
+    g_string_free(cache_dir, TRUE);
+    g_string_free(data_dir, TRUE);
+
+    return result;
+}
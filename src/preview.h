@@ -0,0 +1,26 @@
+/*
+ * (C) Copyright 2019, Arnaud Ferraris <arnaud.ferraris@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ */
+
+#ifndef _VFR_PREVIEW_H
+#define _VFR_PREVIEW_H
+
+#include <gio/gio.h>
+
+#include "provider.h"
+
+#define VFR_PREVIEW_THUMBNAIL_WIDTH 64
+#define VFR_PREVIEW_PAGE_WIDTH 720
+
+typedef enum {
+    VFR_PREVIEW_THUMBNAIL = 0,
+    VFR_PREVIEW_PAGE,
+} VFRPreviewType;
+
+GString *vfr_preview_get_filename(VFRProvider *provider, const gchar *icao,
+                                  VFRPreviewType type);
+gboolean vfr_preview_render_provider(VFRProvider *provider, GCancellable *cancellable);
+
+#endif /* _VFR_PREVIEW_H */
@@ -8,13 +8,14 @@
 
 #include "provider-basulm-apikey.h"
 
+#include "basulm-parser.h"
+#include "terrain-arena.h"
 #include "utils.h"
 
 #include <ctype.h>
 
 #include <curl/curl.h>
 #include <glib/gstdio.h>
-#include <json-glib/json-glib.h>
 
 static CURL *basulm_create_request(struct curl_slist **headers)
 {
@@ -49,28 +50,72 @@ static GString *basulm_read_latest_version(VFRProvider *self)
     return version;
 }
 
+static void basulm_write_version(VFRProvider *self, GString *version)
+{
+    GString *version_file = g_string_new(g_get_user_data_dir());
+    FILE *file;
+
+    g_string_append_printf(version_file, "/librevfr/%s/version", vfr_provider_get_id(self));
+
+    file = g_fopen(version_file->str, "w");
+    if (file) {
+        fprintf(file, "%s", version->str);
+        fclose(file);
+    }
+
+    g_string_free(version_file, TRUE);
+}
+
+// Whether the list changed since the last update, according to its headers
+static gboolean basulm_list_changed(VFRProvider *self)
+{
+    struct curl_slist *headers;
+    CURL *curl = basulm_create_request(&headers);
+    GString *url = g_string_new(vfr_provider_get_base_url(self));
+    gchar *fingerprint;
+    gboolean changed;
+
+    g_string_append(url, "/getbasulm/get/basulm/liste");
+    fingerprint = vfr_provider_probe(self, curl, url->str, NULL);
+    changed = vfr_provider_is_remote_changed(self, fingerprint);
+
+    curl_easy_cleanup(curl);
+    curl_slist_free_all(headers);
+    g_string_free(url, TRUE);
+    g_free(fingerprint);
+
+    return changed;
+}
+
 static gboolean basulm_needs_update(VFRProvider *self)
 {
     GString *data_version = g_string_new(g_get_user_data_dir());
-    GString *data_list = g_string_new(g_get_user_data_dir());
+    GString *data_index = g_string_new(g_get_user_data_dir());
     GString *current_version = vfr_get_current_date();
     GString *latest_version = basulm_read_latest_version(self);
     gboolean result = FALSE;
 
     g_string_append_printf(data_version, "/librevfr/%s/version", vfr_provider_get_id(self));
-    g_string_append_printf(data_list, "/librevfr/%s/list", vfr_provider_get_id(self));
+    g_string_append_printf(data_index, "/librevfr/%s/index", vfr_provider_get_id(self));
 
     if (!vfr_provider_check_dirs(self) ||
         g_access(data_version->str, F_OK) < 0 ||
-        g_access(data_list->str, F_OK) < 0) {
+        g_access(data_index->str, F_OK) < 0) {
         result = TRUE;
     }
 
-    if (!latest_version || !g_string_equal(latest_version, current_version))
-        result = TRUE;
+    /*
+     * The list is checked once a day, but only downloaded again if it
+     * changed since the last update.
+     */
+    if (!result && (!latest_version || !g_string_equal(latest_version, current_version))) {
+        result = basulm_list_changed(self);
+        if (!result)
+            basulm_write_version(self, current_version);
+    }
 
     g_string_free(data_version, TRUE);
-    g_string_free(data_list, TRUE);
+    g_string_free(data_index, TRUE);
     g_string_free(current_version, TRUE);
     if (latest_version)
         g_string_free(latest_version, TRUE);
@@ -78,103 +123,114 @@ static gboolean basulm_needs_update(VFRProvider *self)
     return result;
 }
 
-static gboolean basulm_update_list(VFRProvider *self)
-{
-    struct curl_slist *headers;
-    CURL *curl = basulm_create_request(&headers);
+typedef struct {
+    VFRProvider *provider;
+    VFRBasulmParser *parser;
+} VFRBasulmTransfer;
 
-    GString *tmpfile = g_string_new(g_get_tmp_dir());
-    GString *url = g_string_new("https://basulm.ffplum.fr/getbasulm/get/basulm/liste");
-    FILE *file;
+static void basulm_transfer_reset(gpointer data)
+{
+    VFRBasulmTransfer *transfer = data;
 
-    JsonNode *root;
-    JsonNode *node;
-    JsonObject *object;
-    JsonArray *array;
-    JsonParser *parser = json_parser_new();
+    vfr_basulm_parser_reset(transfer->parser);
+}
 
-    guint count;
+static size_t basulm_write_cb(char *ptr, size_t size, size_t nmemb, void *userdata)
+{
+    VFRBasulmTransfer *transfer = userdata;
 
-    g_string_append_printf(tmpfile, "/librevfr-%s-list", vfr_provider_get_id(self));
-    file = g_fopen(tmpfile->str, "w+");
+    // Returning a short count makes curl abort the transfer
+    if (vfr_provider_is_cancelled(transfer->provider))
+        return 0;
 
-    curl_easy_setopt(curl, CURLOPT_URL, url->str);
-    g_string_free(url, TRUE);
+    if (!vfr_basulm_parser_feed(transfer->parser, ptr, size * nmemb))
+        return 0;
 
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, file);
-    curl_easy_perform(curl);
-    fclose(file);
+    return size * nmemb;
+}
 
-    // Parse data
-    if (!json_parser_load_from_file(parser, tmpfile->str, NULL))
-        return FALSE;
+static gboolean basulm_update_list(VFRProvider *self, VFRTerrainArena *arena)
+{
+    struct curl_slist *headers;
+    CURL *curl = basulm_create_request(&headers);
+    GString *url = g_string_new(vfr_provider_get_base_url(self));
+    VFRBasulmTransfer transfer = { 0 };
+    CURLcode res;
+    glong status = 0;
+    gboolean result;
+
+    transfer.provider = self;
+    transfer.parser = vfr_basulm_parser_new(arena);
+
+    g_string_append(url, "/getbasulm/get/basulm/liste");
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, basulm_write_cb);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &transfer);
+    res = vfr_provider_perform(self, curl, url->str, basulm_transfer_reset, &transfer, &status);
+    curl_easy_cleanup(curl);
+    g_string_free(url, TRUE);
+    curl_slist_free_all(headers);
 
-    g_remove(tmpfile->str);
-    g_string_free(tmpfile, TRUE);
+    result = res == CURLE_OK && status < 400 && vfr_basulm_parser_end(transfer.parser) &&
+             vfr_terrain_arena_get_terrains(arena)->len > 0;
 
-    root = json_parser_get_root(parser);
-    object = json_node_get_object(root);
+    vfr_basulm_parser_free(transfer.parser);
 
-    if (!g_str_equal(json_object_get_string_member(object, "status"), "ok"))
+    // Never replace the current list with a partial or empty one
+    if (!result) {
+        printf("%s: unable to download terrains list\n", vfr_provider_get_id(self));
         return FALSE;
-
-    array = json_object_get_array_member(object, "liste");
-    count = json_array_get_length(array);
-    for (guint i = 0; i < count; i++) {
-        VFRTerrain *terrain;
-        const gchar *name;
-        const gchar *code;
-
-        node = json_array_get_element(array, i);
-        object = json_node_get_object(node);
-        name = json_object_get_string_member(object, "toponyme");
-        code = json_object_get_string_member(object, "code_terrain");
-
-        terrain = vfr_terrain_new(name, code, FALSE);
-        vfr_provider_add_terrain(self, terrain);
     }
 
-    g_object_unref(parser);
+    return vfr_provider_write_terrains(self, vfr_terrain_arena_get_terrains(arena));
+}
 
-    return vfr_provider_write_list(self);
+static gchar *basulm_chart_url(VFRProvider *self, const gchar *icao, const gchar *cycle)
+{
+    return g_strdup_printf("%s/PDF/%s.pdf", vfr_provider_get_base_url(self), icao);
 }
 
 static gboolean basulm_update_terrains(VFRProvider *self)
 {
-    CURL *curl = curl_easy_init();
-    GString *current_date = vfr_get_current_date();
-    GString *data_version = g_string_new(g_get_user_data_dir());
-    GString *data_dir = g_string_new(g_get_user_data_dir());
-    GString *base_url = g_string_new("https://basulm.ffplum.fr/PDF/");
-    GString *vacfile = g_string_new(NULL);
-    GString *url = g_string_new(NULL);
-    FILE *file;
-
-    g_string_append_printf(data_version, "/librevfr/%s/version", vfr_provider_get_id(self));
-    g_string_append_printf(data_dir, "/librevfr/%s/files", vfr_provider_get_id(self));
-
-    basulm_update_list(self);
-
-    for (guint i = 0; i < vfr_provider_get_terrain_count(self); i++) {
-        VFRTerrain *terrain = vfr_provider_get_terrain_by_index(self, i);
-
-        g_string_printf(vacfile, "%s/%s.pdf", data_dir->str, vfr_terrain_get_icao(terrain));
-        file = g_fopen(vacfile->str, "w");
-
-        g_string_printf(url, "%s/%s.pdf", base_url->str, vfr_terrain_get_icao(terrain));
+    VFRDownloader *downloader = vfr_provider_create_downloader(self, 0);
+    VFRTerrainArena *arena = vfr_terrain_arena_new();
+    GPtrArray *terrains = vfr_terrain_arena_get_terrains(arena);
+    GString *current_date;
+
+    /*
+     * Forced updates and first installs don't probe the list beforehand:
+     * do it now (before downloading it, so that a change made meanwhile
+     * isn't missed), or the next daily check would download it again.
+     */
+    if (!vfr_provider_is_remote_known(self))
+        basulm_list_changed(self);
+
+    if (!basulm_update_list(self, arena)) {
+        vfr_terrain_arena_free(arena);
+        vfr_downloader_free(downloader);
+        return FALSE;
+    }
 
-        curl_easy_setopt(curl, CURLOPT_URL, url->str);
-        curl_easy_setopt(curl, CURLOPT_WRITEDATA, file);
-        curl_easy_perform(curl);
+    for (guint i = 0; i < terrains->len; i++) {
+        VFRTerrain *terrain = terrains->pdata[i];
+        gchar *url = basulm_chart_url(self, vfr_terrain_get_icao(terrain), NULL);
 
-        fclose(file);
+        vfr_provider_queue_chart(self, downloader, terrain, url);
+        g_free(url);
     }
+    vfr_provider_list_ready(self);
 
-    curl_easy_cleanup(curl);
+    vfr_downloader_run(downloader);
+    vfr_downloader_free(downloader);
+    vfr_manifest_save(vfr_provider_get_manifest(self));
+    vfr_terrain_arena_free(arena);
+
+    // Don't mark an interrupted update as complete
+    if (vfr_provider_is_cancelled(self))
+        return FALSE;
 
-    file = g_fopen(data_version->str, "w");
-    fprintf(file, "%s", current_date->str);
-    fclose(file);
+    current_date = vfr_get_current_date();
+    basulm_write_version(self, current_date);
+    g_string_free(current_date, TRUE);
 
     return TRUE;
 }
@@ -183,7 +239,9 @@ VFRProvider *vfr_provider_basulm_init(void)
 {
     VFRProvider *self = vfr_provider_new("BASULM France", "basulm");
 
+    vfr_provider_set_base_url(self, "https://basulm.ffplum.fr");
     vfr_provider_set_callbacks(self, basulm_needs_update, basulm_update_terrains);
+    vfr_provider_set_chart_url_func(self, basulm_chart_url);
 
     return self;
 }
@@ -6,158 +6,240 @@
 
 #include "provider-sia.h"
 
+#include "sia-parser.h"
+#include "terrain-arena.h"
 #include "utils.h"
 
-#include <ctype.h>
-
 #include <curl/curl.h>
 #include <glib/gstdio.h>
 
+/*
+ * Charts of the next AIRAC cycle are published in advance: they are staged
+ * during the last days of the current cycle, with fewer parallel transfers,
+ * and activated as soon as the new cycle is in effect.
+ */
+#define SIA_PRESTAGE_DAYS 7
+#define SIA_PRESTAGE_TRANSFERS 2
+
+static gboolean sia_should_prestage(VFRProvider *self, const gchar *next_airac)
+{
+    time_t start = vfr_get_airac_date(VFR_AIRAC_NEXT) - SIA_PRESTAGE_DAYS * 24 * 3600;
+
+    return time(NULL) >= start && !vfr_provider_is_cycle_staged(self, next_airac);
+}
+
+static gchar *sia_list_url(VFRProvider *self, const gchar *airac)
+{
+    return g_strdup_printf("%s/dvd/eAIP_%s/Atlas-VAC/Javascript/AeroArraysVac.js",
+                           vfr_provider_get_base_url(self), airac);
+}
+
+/*
+ * The next cycle is published some time before it is in effect: check that
+ * its terrains list is available (only requesting its headers) rather than
+ * attempting to stage it every time. Both sia_needs_update() and
+ * sia_update_terrains() need to know, the sync only probes it once.
+ */
+static gboolean sia_is_published(VFRProvider *self, const gchar *airac)
+{
+    gchar *url = sia_list_url(self, airac);
+    glong status = vfr_provider_probe_status(self, url);
+
+    g_free(url);
+
+    return status > 0 && status < 400;
+}
+
 static gboolean sia_needs_update(VFRProvider *self)
 {
-    GString *data_airac = g_string_new(g_get_user_data_dir());
-    GString *data_list = g_string_new(g_get_user_data_dir());
-    GString *current_airac = NULL;
-    char cached_airac[16];
-    FILE *file;
-
-    g_string_append_printf(data_airac, "/librevfr/%s/version", vfr_provider_get_id(self));
-    g_string_append_printf(data_list, "/librevfr/%s/list", vfr_provider_get_id(self));
-
-    if (!vfr_provider_check_dirs(self) ||
-        g_access(data_airac->str, F_OK) < 0 ||
-        g_access(data_list->str, F_OK) < 0) {
-        goto update_needed;
-    }
+    GString *current_airac = vfr_get_airac(VFR_AIRAC_CURRENT);
+    GString *next_airac = vfr_get_airac(VFR_AIRAC_NEXT);
+    gchar *active_airac = vfr_provider_get_active_cycle(self);
+    gboolean result;
+
+    // The active cycle may have been activated before being complete
+    result = g_strcmp0(active_airac, current_airac->str) != 0 ||
+             !vfr_provider_is_cycle_staged(self, current_airac->str) ||
+             (sia_should_prestage(self, next_airac->str) &&
+              sia_is_published(self, next_airac->str));
+
+    g_free(active_airac);
+    g_string_free(current_airac, TRUE);
+    g_string_free(next_airac, TRUE);
+
+    return result;
+}
+
+typedef struct {
+    VFRProvider *provider;
+    VFRSiaParser *parser;
+} VFRSiaTransfer;
 
-    file = g_fopen(data_airac->str, "r");
-    if (!file)
-        goto update_needed;
+static void sia_transfer_reset(gpointer data)
+{
+    VFRSiaTransfer *transfer = data;
 
-    memset(cached_airac, 0, 16);
-    fread(cached_airac, 16, 1, file);
-    fclose(file);
+    vfr_sia_parser_reset(transfer->parser);
+}
 
-    current_airac = vfr_get_current_airac();
-    if (!g_str_equal(cached_airac, current_airac->str))
-        goto update_needed;
+static size_t sia_write_cb(char *ptr, size_t size, size_t nmemb, void *userdata)
+{
+    VFRSiaTransfer *transfer = userdata;
 
-    return FALSE;
+    // Returning a short count makes curl abort the transfer
+    if (vfr_provider_is_cancelled(transfer->provider))
+        return 0;
 
-update_needed:
-    g_string_free(data_airac, TRUE);
-    g_string_free(data_list, TRUE);
-    if (current_airac)
-        g_string_free(current_airac, TRUE);
-    return TRUE;
+    vfr_sia_parser_feed(transfer->parser, ptr, size * nmemb);
+
+    return size * nmemb;
 }
 
-static gboolean sia_update_list(VFRProvider *self)
+static gboolean sia_update_list(VFRProvider *self, VFRTerrainArena *arena, const gchar *airac)
 {
     CURL *curl = curl_easy_init();
-    GString *tmpfile = g_string_new(g_get_tmp_dir());
-    GString *url = g_string_new("https://www.sia.aviation-civile.gouv.fr/dvd/eAIP_");
-    GString *airac = vfr_get_current_airac();
-    char *line = NULL;
-    size_t len = 0;
-    char **icao;
-    char **name;
-    char *start;
-    char *end;
-    FILE *file;
-
-    g_string_append_printf(tmpfile, "/librevfr-%s-list", vfr_provider_get_id(self));
-    file = g_fopen(tmpfile->str, "w+");
-
-    g_string_append_printf(url, "%s/Atlas-VAC/Javascript/AeroArraysVac.js", airac->str);
-    curl_easy_setopt(curl, CURLOPT_URL, url->str);
-    g_string_free(url, TRUE);
-
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, file);
-    curl_easy_perform(curl);
-
-    fseek(file, 0, SEEK_SET);
-    getline(&line, &len, file);
-    start = strchr(line, '\"') + 1;
-    end = strrchr(line, '\"');
-    *end = 0;
-    icao = g_strsplit(start, "\",\"", 0);
-    getline(&line, &len, file);
-    start = strchr(line, '\"') + 1;
-    end = strrchr(line, '\"');
-    *end = 0;
-    name = g_strsplit(start, "\",\"", 0);
-    free(line);
-    fclose(file);
-    g_remove(tmpfile->str);
-    g_string_free(tmpfile, TRUE);
-
-    len = 0;
-    while (icao[len]) {
-        VFRTerrain *terrain;
-
-        for (size_t i = 1; i < strlen(name[len]); i++) {
-            if (isupper(name[len][i]) && name[len][i-1] != ' ')
-                name[len][i] += 0x20;
-        }
+    gchar *url = sia_list_url(self, airac);
+    VFRSiaTransfer transfer = { 0 };
+    GPtrArray *terrains;
+    CURLcode res;
+    glong status = 0;
+    guint codes;
+    guint names;
+
+    transfer.provider = self;
+    transfer.parser = vfr_sia_parser_new(arena);
+
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, sia_write_cb);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &transfer);
+    res = vfr_provider_perform(self, curl, url, sia_transfer_reset, &transfer, &status);
+    curl_easy_cleanup(curl);
+    g_free(url);
 
-        terrain = vfr_terrain_new(name[len], icao[len], FALSE);
-        vfr_provider_add_terrain(self, terrain);
-        len++;
+    codes = vfr_sia_parser_get_codes(transfer.parser);
+    names = vfr_sia_parser_get_names(transfer.parser);
+    if (names != codes)
+        printf("%s: %u ICAO codes for %u names\n", vfr_provider_get_id(self), codes, names);
+
+    vfr_sia_parser_free(transfer.parser);
+
+    // Never replace the current list with a partial or empty one
+    terrains = vfr_terrain_arena_get_terrains(arena);
+    if (res != CURLE_OK || status >= 400 || terrains->len == 0) {
+        printf("%s: unable to download terrains list (status %ld)\n",
+               vfr_provider_get_id(self), status);
+        return FALSE;
     }
 
-    g_strfreev(icao);
-    g_strfreev(name);
+    return vfr_provider_write_terrains(self, terrains);
+}
+
+static gchar *sia_chart_url(VFRProvider *self, const gchar *icao, const gchar *cycle)
+{
+    gchar *active = cycle ? NULL : vfr_provider_get_active_cycle(self);
+    GString *airac = active ? g_string_new(active) : vfr_get_current_airac();
+    gchar *url;
+
+    url = g_strdup_printf("%s/dvd/eAIP_%s/Atlas-VAC/PDF_AIPparSSection/VAC/AD/AD-2.%s.pdf",
+                          vfr_provider_get_base_url(self), cycle ? cycle : airac->str, icao);
 
-    return vfr_provider_write_list(self);
+    g_string_free(airac, TRUE);
+    g_free(active);
+
+    return url;
 }
 
-static gboolean sia_update_terrains(VFRProvider *self)
+// Download the terrains list and charts of a cycle to its own directory
+static gboolean sia_stage_cycle(VFRProvider *self, const gchar *airac, guint max_transfers)
 {
-    CURL *curl = curl_easy_init();
-    GString *current_airac = vfr_get_current_airac();
-    GString *data_airac = g_string_new(g_get_user_data_dir());
-    GString *data_dir = g_string_new(g_get_user_data_dir());
-    GString *base_url = g_string_new("https://www.sia.aviation-civile.gouv.fr/dvd/eAIP_");
-    GString *vacfile = g_string_new(NULL);
-    GString *url = g_string_new(NULL);
-    FILE *file;
+    VFRDownloader *downloader;
+    VFRTerrainArena *arena = vfr_terrain_arena_new();
+    GPtrArray *terrains = vfr_terrain_arena_get_terrains(arena);
+    gboolean result = FALSE;
 
-    g_string_append_printf(data_airac, "/librevfr/%s/version", vfr_provider_get_id(self));
-    g_string_append_printf(data_dir, "/librevfr/%s/files", vfr_provider_get_id(self));
-    g_string_append_printf(base_url, "%s/Atlas-VAC/PDF_AIPparSSection/VAC/AD", current_airac->str);
+    vfr_provider_set_stage(self, airac);
 
-    sia_update_list(self);
+    if (!sia_update_list(self, arena, airac))
+        goto out;
 
-    for (guint i = 0; i < vfr_provider_get_terrain_count(self); i++) {
-        VFRTerrain *terrain = vfr_provider_get_terrain_by_index(self, i);
+    downloader = vfr_provider_create_downloader(self, max_transfers);
+    for (guint i = 0; i < terrains->len; i++) {
+        VFRTerrain *terrain = terrains->pdata[i];
+        gchar *url = sia_chart_url(self, vfr_terrain_get_icao(terrain), airac);
 
-        g_string_printf(vacfile, "%s/%s.pdf", data_dir->str, vfr_terrain_get_icao(terrain));
-        file = g_fopen(vacfile->str, "w");
+        vfr_provider_queue_chart(self, downloader, terrain, url);
+        g_free(url);
+    }
+
+    // Charts are downloaded by priority: make them usable as they arrive
+    vfr_provider_activate_stage(self);
+    vfr_provider_list_ready(self);
+
+    vfr_downloader_run(downloader);
+    vfr_downloader_free(downloader);
 
-        g_string_printf(url, "%s/AD-2.%s.pdf", base_url->str, vfr_terrain_get_icao(terrain));
+    // Don't mark an interrupted update as complete
+    if (!vfr_provider_is_cancelled(self))
+        result = vfr_provider_commit_stage(self);
 
-        curl_easy_setopt(curl, CURLOPT_URL, url->str);
-        curl_easy_setopt(curl, CURLOPT_WRITEDATA, file);
-        curl_easy_perform(curl);
+out:
+    vfr_provider_set_stage(self, NULL);
+    vfr_terrain_arena_free(arena);
 
-        fclose(file);
+    return result;
+}
+
+static gboolean sia_update_terrains(VFRProvider *self)
+{
+    GString *current_airac = vfr_get_airac(VFR_AIRAC_CURRENT);
+    GString *next_airac = vfr_get_airac(VFR_AIRAC_NEXT);
+    gchar *active_airac = vfr_provider_get_active_cycle(self);
+    const gchar *keep[] = { current_airac->str, next_airac->str, NULL, NULL };
+    gboolean is_active = g_strcmp0(active_airac, current_airac->str) == 0;
+    gboolean is_staged = vfr_provider_is_cycle_staged(self, current_airac->str);
+    gboolean prestage = sia_should_prestage(self, next_airac->str) &&
+                        sia_is_published(self, next_airac->str);
+    gboolean updated = FALSE;
+
+    /*
+     * The current cycle may already have been staged in advance, in which
+     * case it only needs to be activated. When it is already active and
+     * complete, it is refreshed only if there's nothing else to do (forced
+     * update).
+     */
+    if (!is_active || !is_staged || !prestage) {
+        if ((!is_active && is_staged) ||
+            sia_stage_cycle(self, current_airac->str, 0)) {
+            updated = vfr_provider_activate_cycle(self, current_airac->str);
+        }
     }
 
-    curl_easy_cleanup(curl);
+    if (prestage && !vfr_provider_is_cancelled(self) &&
+        !sia_stage_cycle(self, next_airac->str, SIA_PRESTAGE_TRANSFERS)) {
+        printf("%s: unable to stage AIRAC cycle %s\n", vfr_provider_get_id(self),
+                                                      next_airac->str);
+    }
+
+    // Only remove older cycles once one was activated, and never that one
+    g_free(active_airac);
+    active_airac = vfr_provider_get_active_cycle(self);
+    keep[2] = active_airac;
+    if (active_airac && !vfr_provider_is_cancelled(self))
+        vfr_provider_prune_cycles(self, keep);
 
-    file = g_fopen(data_airac->str, "w");
-    fprintf(file, "%s", current_airac->str);
-    fclose(file);
+    g_free(active_airac);
+    g_string_free(current_airac, TRUE);
+    g_string_free(next_airac, TRUE);
 
-    return TRUE;
+    return updated;
 }
 
 VFRProvider *vfr_provider_sia_init(void)
 {
     VFRProvider *self = vfr_provider_new("VAC France", "sia");
 
+    vfr_provider_set_base_url(self, "https://www.sia.aviation-civile.gouv.fr");
     vfr_provider_set_callbacks(self, sia_needs_update, sia_update_terrains);
+    vfr_provider_set_chart_url_func(self, sia_chart_url);
 
     return self;
 }
@@ -8,42 +8,132 @@
 
 #include "provider-sia.h"
 #include "provider-basulm.h"
+#include "chart-cache.h"
+#include "flight.h"
+#include "net-policy.h"
+#include "preview.h"
+#include "store.h"
+#include "terrain-arena.h"
+#include "terrain-index.h"
+#include "terrain-list.h"
+#include "terrain-snapshot.h"
+#include "user-state.h"
+#include "utils.h"
 
+#include <string.h>
 #include <unistd.h>
 
+#include <curl/curl.h>
 #include <glib/gstdio.h>
 
+typedef struct {
+    gint ref_count;
+    VFRProvider *provider;
+    GMainContext *context;
+
+    vfr_provider_progress_cb progress;
+    vfr_provider_sync_cb callback;
+    gpointer data;
+
+    gint done;
+    gint total;
+    gint progress_pending;
+
+    // Terrains loaded by the sync thread, published once it completes
+    VFRTerrainSnapshot *snapshot;
+} VFRProviderSync;
+
+typedef struct {
+    VFRProviderSync *sync;
+    VFRTerrainSnapshot *snapshot;
+} VFRProviderReady;
+
 struct _VFRProvider {
     GString *name;
     GString *id;
+    GString *base_url;
+
+    /*
+     * Terrains currently shown, only ever replaced from the main thread:
+     * other threads must hold a reference, see vfr_provider_get_snapshot().
+     * The initial list is published by the providers loader, before any
+     * reader may access it.
+     */
+    VFRTerrainSnapshot *snapshot;
+    VFRTerrainList *model;
+    VFRManifest *manifest;
+
+    // Cycle being staged by the running update, if any
+    GString *stage;
+    VFRManifest *seed;
+
+    // Fingerprint of the remote catalogue, saved once the update succeeded
+    GString *remote;
 
-    GPtrArray *terrains;
+    // HTTP status of the files probed by the running sync, by URL
+    GHashTable *probed;
 
     vfr_provider_cb needs_update;
     vfr_provider_cb update_terrains;
+    vfr_provider_url_cb chart_url;
+
+    // Only set while a synchronisation is running
+    VFRProviderSync *sync;
+    GCancellable *cancellable;
+    VFRSyncStats stats;
+
+    // Previews are being rendered, and must be again once done
+    gboolean rendering;
+    gboolean render_again;
+    GCancellable *render_cancellable;
 };
 
+static GPtrArray *providers = NULL;
+static GMutex snapshot_lock;
+
+static VFRTerrainSnapshot *provider_load_snapshot(VFRProvider *self);
+
+/*
+ * Only load the cached terrain lists here: synchronising with the remote
+ * servers is done in the background by vfr_provider_sync_async().
+ */
+// curl_global_init() must have been called before any other thread started
 GPtrArray *vfr_provider_init(void)
 {
-    GPtrArray *array = g_ptr_array_new();
+    vfr_provider_register(vfr_provider_sia_init());
+    vfr_provider_register(vfr_provider_basulm_init());
+
+    for (guint i = 0; i < providers->len; i++)
+        vfr_provider_load_terrains(providers->pdata[i]);
+
+    return providers;
+}
 
-    g_ptr_array_add(array, vfr_provider_sia_init());
-    g_ptr_array_add(array, vfr_provider_basulm_init());
+// Providers registered so far, see vfr_provider_init()
+GPtrArray *vfr_provider_get_all(void)
+{
+    return providers;
+}
 
-    for (guint i = 0; i < array->len; i++) {
-        VFRProvider *provider = array->pdata[i];
+VFRProvider *vfr_provider_register(VFRProvider *provider)
+{
+    if (!providers)
+        providers = g_ptr_array_new();
 
-        if (provider->needs_update(provider)) {
+    if (provider)
+        g_ptr_array_add(providers, provider);
 
-            printf("%s (ID %s) needs update\n", vfr_provider_get_name(provider),
-                                                vfr_provider_get_id(provider));
-            provider->update_terrains(provider);
-        }
+    return provider;
+}
 
-        vfr_provider_load_terrains(provider);
+VFRProvider *vfr_provider_get_by_id(const gchar *id)
+{
+    for (guint i = 0; providers && id && i < providers->len; i++) {
+        if (g_str_equal(vfr_provider_get_id(providers->pdata[i]), id))
+            return providers->pdata[i];
     }
 
-    return array;
+    return NULL;
 }
 
 VFRProvider *vfr_provider_new(const gchar *name, const gchar *id)
@@ -52,7 +142,10 @@ VFRProvider *vfr_provider_new(const gchar *name, const gchar *id)
 
     provider->name = g_string_new(name);
     provider->id = g_string_new(id);
-    provider->terrains = g_ptr_array_new();
+    provider->base_url = g_string_new(NULL);
+    provider->stage = g_string_new(NULL);
+    provider->remote = g_string_new(NULL);
+    provider->probed = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
 
     return provider;
 }
@@ -73,36 +166,180 @@ const gchar *vfr_provider_get_id(VFRProvider *provider)
     return NULL;
 }
 
+const gchar *vfr_provider_get_base_url(VFRProvider *provider)
+{
+    if (provider)
+        return provider->base_url->str;
+
+    return NULL;
+}
+
+// Allows pointing a provider to a mirror or a local test server
+void vfr_provider_set_base_url(VFRProvider *provider, const gchar *url)
+{
+    if (!provider || !url)
+        return;
+
+    g_string_assign(provider->base_url, url);
+    while (provider->base_url->len > 0 &&
+           provider->base_url->str[provider->base_url->len - 1] == '/') {
+        g_string_truncate(provider->base_url, provider->base_url->len - 1);
+    }
+}
+
 guint vfr_provider_get_terrain_count(VFRProvider *provider)
 {
     if (provider)
-        return provider->terrains->len;
+        return vfr_terrain_snapshot_get_count(provider->snapshot);
 
     return 0;
 }
 
 VFRTerrain *vfr_provider_get_terrain_by_name(VFRProvider *provider, GString *name)
 {
-    return NULL;
+    VFRTerrain *terrain;
+    gchar *key;
+
+    if (!provider || !name)
+        return NULL;
+
+    key = vfr_normalize_string(name->str);
+    terrain = vfr_terrain_snapshot_lookup_name(provider->snapshot, key);
+    g_free(key);
+
+    return terrain;
 }
 
 VFRTerrain *vfr_provider_get_terrain_by_icao(VFRProvider *provider, GString *icao)
 {
+    if (provider && icao)
+        return vfr_terrain_snapshot_lookup_icao(provider->snapshot, icao->str);
+
     return NULL;
 }
 
 VFRTerrain *vfr_provider_get_terrain_by_index(VFRProvider *provider, int index)
 {
     if (provider)
-        return provider->terrains->pdata[index];
+        return vfr_terrain_snapshot_get(provider->snapshot, index);
+
+    return NULL;
+}
+
+GListModel *vfr_provider_get_model(VFRProvider *provider)
+{
+    if (!provider)
+        return NULL;
+
+    if (!provider->model)
+        provider->model = vfr_terrain_list_new(provider);
+
+    return G_LIST_MODEL(provider->model);
+}
+
+VFRTerrain *vfr_provider_find_terrain_by_name(GString *name, VFRProvider **provider)
+{
+    VFRTerrain *terrain = NULL;
+    gchar *key;
+
+    if (!providers || !name)
+        return NULL;
+
+    key = vfr_normalize_string(name->str);
+    for (guint i = 0; i < providers->len && !terrain; i++) {
+        terrain = vfr_terrain_snapshot_lookup_name(((VFRProvider *)providers->pdata[i])->snapshot,
+                                                   key);
+        if (terrain && provider)
+            *provider = providers->pdata[i];
+    }
+    g_free(key);
+
+    return terrain;
+}
+
+VFRTerrain *vfr_provider_find_terrain_by_icao(GString *icao, VFRProvider **provider)
+{
+    VFRTerrain *terrain;
+
+    if (!providers || !icao)
+        return NULL;
+
+    for (guint i = 0; i < providers->len; i++) {
+        terrain = vfr_provider_get_terrain_by_icao(providers->pdata[i], icao);
+        if (terrain) {
+            if (provider)
+                *provider = providers->pdata[i];
+            return terrain;
+        }
+    }
 
     return NULL;
 }
 
-void vfr_provider_add_terrain(VFRProvider *provider, VFRTerrain *terrain)
+/*
+ * Favourites are part of the user state, which is journaled: changing one
+ * doesn't rewrite the terrains list.
+ */
+gboolean vfr_provider_is_favorite(VFRProvider *provider, const gchar *icao)
+{
+    if (provider)
+        return vfr_user_state_is_favorite(vfr_provider_get_id(provider), icao);
+
+    return FALSE;
+}
+
+gboolean vfr_provider_set_favorite(VFRProvider *provider, const gchar *icao, gboolean favorite)
+{
+    if (provider)
+        return vfr_user_state_set_favorite(vfr_provider_get_id(provider), icao, favorite);
+
+    return FALSE;
+}
+
+/*
+ * Current terrains list, for the main thread only: as it is the one
+ * replacing it, the list can be used (or referenced) without locking.
+ */
+VFRTerrainSnapshot *vfr_provider_peek_snapshot(VFRProvider *provider)
+{
+    return provider ? provider->snapshot : NULL;
+}
+
+/*
+ * Reference to the current terrains list from any thread, which remains
+ * valid even if the provider switches to a new one meanwhile. Main thread
+ * code should use vfr_provider_peek_snapshot() instead.
+ */
+VFRTerrainSnapshot *vfr_provider_get_snapshot(VFRProvider *provider)
+{
+    VFRTerrainSnapshot *snapshot;
+
+    if (!provider)
+        return NULL;
+
+    g_mutex_lock(&snapshot_lock);
+    snapshot = vfr_terrain_snapshot_ref(provider->snapshot);
+    g_mutex_unlock(&snapshot_lock);
+
+    return snapshot;
+}
+
+/*
+ * Switch to a new terrains list, from the main thread. Readers on the main
+ * thread don't need to lock: the lock only protects threads taking a
+ * reference to the list being replaced.
+ */
+static void provider_publish_snapshot(VFRProvider *self, VFRTerrainSnapshot *snapshot)
 {
-    if (provider && terrain)
-        g_ptr_array_add(provider->terrains, terrain);
+    VFRTerrainSnapshot *previous;
+
+    g_mutex_lock(&snapshot_lock);
+    previous = self->snapshot;
+    self->snapshot = snapshot;
+    g_mutex_unlock(&snapshot_lock);
+
+    vfr_terrain_list_refresh(self->model);
+    vfr_terrain_snapshot_unref(previous);
 }
 
 void vfr_provider_set_callbacks(VFRProvider *provider, vfr_provider_cb needs_update,
@@ -114,78 +351,1245 @@ void vfr_provider_set_callbacks(VFRProvider *provider, vfr_provider_cb needs_upd
     }
 }
 
-gboolean vfr_provider_check_dirs(VFRProvider *self)
+void vfr_provider_set_chart_url_func(VFRProvider *provider, vfr_provider_url_cb chart_url)
 {
-    GString *data_dir = g_string_new(g_get_user_data_dir());
+    if (provider)
+        provider->chart_url = chart_url;
+}
 
-    g_string_append_printf(data_dir, "/librevfr/%s/files", vfr_provider_get_id(self));
+/*
+ * URL of a terrain's chart, for the given cycle or the active one if
+ * `cycle` is NULL.
+ */
+gchar *vfr_provider_get_chart_url(VFRProvider *self, const gchar *icao, const gchar *cycle)
+{
+    if (self && self->chart_url && icao)
+        return self->chart_url(self, icao, cycle);
 
-    if (g_access(data_dir->str, F_OK) < 0) {
-        g_mkdir_with_parents(data_dir->str, 0755);
-        g_string_free(data_dir, TRUE);
-        return FALSE;
+    return NULL;
+}
+
+static VFRProviderSync *provider_sync_ref(VFRProviderSync *sync)
+{
+    g_atomic_int_inc(&sync->ref_count);
+
+    return sync;
+}
+
+static void provider_sync_unref(VFRProviderSync *sync)
+{
+    if (!g_atomic_int_dec_and_test(&sync->ref_count))
+        return;
+
+    vfr_terrain_snapshot_unref(sync->snapshot);
+    g_main_context_unref(sync->context);
+    g_free(sync);
+}
+
+static gboolean provider_sync_progress_cb(gpointer data)
+{
+    VFRProviderSync *sync = data;
+
+    g_atomic_int_set(&sync->progress_pending, FALSE);
+
+    // Don't report the progress of a sync which already completed
+    if (sync->progress && sync->provider->sync == sync) {
+        sync->progress(sync->provider, g_atomic_int_get(&sync->done),
+                       g_atomic_int_get(&sync->total), sync->data);
     }
 
-    return TRUE;
+    return G_SOURCE_REMOVE;
 }
 
-gboolean vfr_provider_write_list(VFRProvider *self)
+// Called from the sync thread, progress is reported in the caller's context
+static void provider_sync_report(VFRProviderSync *sync)
 {
-    GString *data_list = g_string_new(g_get_user_data_dir());
-    char *line = NULL;
-    size_t size = 0;
-    gboolean favorite;
-    FILE *file;
-    int len;
+    if (!sync || !sync->progress)
+        return;
 
-    g_string_append_printf(data_list, "/librevfr/%s/list", vfr_provider_get_id(self));
-    file = g_fopen(data_list->str, "w");
-    if (!file)
-        return FALSE;
+    if (g_atomic_int_compare_and_exchange(&sync->progress_pending, FALSE, TRUE)) {
+        g_main_context_invoke_full(sync->context, G_PRIORITY_DEFAULT,
+                                   provider_sync_progress_cb, provider_sync_ref(sync),
+                                   (GDestroyNotify)provider_sync_unref);
+    }
+}
+
+static void provider_ready_free(VFRProviderReady *ready)
+{
+    vfr_terrain_snapshot_unref(ready->snapshot);
+    provider_sync_unref(ready->sync);
+    g_free(ready);
+}
+
+static gboolean provider_sync_list_ready_cb(gpointer data)
+{
+    VFRProviderReady *ready = data;
+    VFRProvider *self = ready->sync->provider;
+
+    // Only when there was nothing to show yet, see vfr_provider_list_ready()
+    if (vfr_provider_get_terrain_count(self) == 0 && ready->snapshot)
+        provider_publish_snapshot(self, g_steal_pointer(&ready->snapshot));
+
+    return G_SOURCE_REMOVE;
+}
+
+/*
+ * Called from the sync thread once the new terrains list was written. If no
+ * terrains were loaded yet (first synchronisation), they are loaded now so
+ * that charts can be opened (and fetched on demand) before the sync ends.
+ */
+void vfr_provider_list_ready(VFRProvider *self)
+{
+    VFRTerrainSnapshot *current;
+    VFRProviderReady *ready;
+
+    if (!self || !self->sync)
+        return;
 
-    for (guint i = 0; i < vfr_provider_get_terrain_count(self); i++) {
-        VFRTerrain *terrain = vfr_provider_get_terrain_by_index(self, i);
+    current = vfr_provider_get_snapshot(self);
+    if (vfr_terrain_snapshot_get_count(current) == 0) {
+        ready = g_malloc0(sizeof(VFRProviderReady));
+        ready->sync = provider_sync_ref(self->sync);
+        ready->snapshot = provider_load_snapshot(self);
 
-        fprintf(file, "%s;%s;%d\n", vfr_terrain_get_name(terrain),
-                                    vfr_terrain_get_icao(terrain),
-                                    vfr_terrain_is_favorite(terrain));
+        g_main_context_invoke_full(self->sync->context, G_PRIORITY_DEFAULT,
+                                   provider_sync_list_ready_cb, ready,
+                                   (GDestroyNotify)provider_ready_free);
     }
-    fclose(file);
+    vfr_terrain_snapshot_unref(current);
+}
 
-    return TRUE;
+static void provider_sync_thread(GTask *task, gpointer source, gpointer task_data,
+                                 GCancellable *cancellable)
+{
+    VFRProviderSync *sync = task_data;
+    VFRProvider *self = sync->provider;
+    gboolean updated;
+
+    updated = vfr_provider_sync(self, FALSE);
+
+    // Build the new terrains list here, it only has to be switched to
+    if (updated)
+        sync->snapshot = provider_load_snapshot(self);
+
+    if (!g_task_return_error_if_cancelled(task))
+        g_task_return_boolean(task, updated);
 }
 
-gboolean vfr_provider_load_terrains(VFRProvider *self)
+static void provider_render_previews(VFRProvider *self, GCancellable *cancellable);
+
+static void provider_render_thread(GTask *task, gpointer source, gpointer task_data,
+                                   GCancellable *cancellable)
 {
-    GString *data_list = g_string_new(g_get_user_data_dir());
-    char *line = NULL;
-    size_t size = 0;
-    gboolean favorite;
-    FILE *file;
-    int len;
+    g_task_return_boolean(task, vfr_preview_render_provider(task_data, cancellable));
+}
 
-    g_string_append_printf(data_list, "/librevfr/%s/list", vfr_provider_get_id(self));
-    file = g_fopen(data_list->str, "r");
-    if (!file)
+static void provider_render_ready_cb(GObject *source, GAsyncResult *result, gpointer data)
+{
+    VFRProvider *self = g_task_get_task_data(G_TASK(result));
+    GCancellable *cancellable = g_steal_pointer(&self->render_cancellable);
+
+    self->rendering = FALSE;
+
+    // Charts were updated again in the meantime
+    if (self->render_again && !g_cancellable_is_cancelled(cancellable))
+        provider_render_previews(self, cancellable);
+
+    g_clear_object(&cancellable);
+}
+
+/*
+ * Previews are rendered in the background once the new terrains list was
+ * published, so that charts are usable sooner. Only one rendering runs at a
+ * time for each provider.
+ */
+static void provider_render_previews(VFRProvider *self, GCancellable *cancellable)
+{
+    GTask *task;
+
+    if (self->rendering) {
+        self->render_again = TRUE;
+        return;
+    }
+
+    self->rendering = TRUE;
+    self->render_again = FALSE;
+    if (cancellable)
+        self->render_cancellable = g_object_ref(cancellable);
+
+    task = g_task_new(NULL, cancellable, provider_render_ready_cb, NULL);
+    g_task_set_task_data(task, self, NULL);
+    g_task_run_in_thread(task, provider_render_thread);
+    g_object_unref(task);
+}
+
+static void provider_sync_ready_cb(GObject *source, GAsyncResult *result, gpointer data)
+{
+    VFRProviderSync *sync = g_task_get_task_data(G_TASK(result));
+    VFRProvider *self = sync->provider;
+    GError *err = NULL;
+    gboolean updated;
+
+    updated = g_task_propagate_boolean(G_TASK(result), &err);
+    if (err) {
+        printf("%s: synchronisation failed: %s\n", vfr_provider_get_id(self), err->message);
+        g_error_free(err);
+    }
+
+    if (updated && sync->snapshot)
+        provider_publish_snapshot(self, g_steal_pointer(&sync->snapshot));
+
+    if (updated)
+        provider_render_previews(self, self->cancellable);
+
+    self->sync = NULL;
+    g_clear_object(&self->cancellable);
+
+    if (sync->callback)
+        sync->callback(self, updated, sync->data);
+}
+
+static GString *provider_get_remote_file(VFRProvider *self)
+{
+    GString *filename = g_string_new(g_get_user_data_dir());
+
+    g_string_append_printf(filename, "/librevfr/%s/remote", vfr_provider_get_id(self));
+
+    return filename;
+}
+
+static void provider_save_remote(VFRProvider *self)
+{
+    GString *filename;
+
+    if (self->remote->len == 0)
+        return;
+
+    filename = provider_get_remote_file(self);
+    g_file_set_contents(filename->str, self->remote->str, self->remote->len, NULL);
+    g_string_free(filename, TRUE);
+}
+
+/*
+ * Synchronise the provider with its remote server, blocking until done.
+ * The terrains list of the provider is not reloaded.
+ */
+gboolean vfr_provider_sync(VFRProvider *self, gboolean force)
+{
+    gboolean updated;
+
+    if (!self)
         return FALSE;
 
-    while ((len = getline(&line, &size, file)) && !feof(file)) {
-        char **split;
-        VFRTerrain *terrain;
+    memset(&self->stats, 0, sizeof(VFRSyncStats));
+    g_string_truncate(self->remote, 0);
+    g_hash_table_remove_all(self->probed);
 
-        line[len-1] = 0;
-        split = g_strsplit(line, ";", 0);
-        if (split && split[0] && split[1]) {
-            if (split[2] && split[2][0] == '1')
-                favorite = TRUE;
-            else
-                favorite = FALSE;
-            terrain = vfr_terrain_new(split[0], split[1], favorite);
-            vfr_provider_add_terrain(self, terrain);
-            g_strfreev(split);
-        }
+    if (!force && !self->needs_update(self))
+        return FALSE;
+
+    printf("%s (ID %s) needs update\n", vfr_provider_get_name(self),
+                                        vfr_provider_get_id(self));
+
+    updated = self->update_terrains(self);
+
+    // Next time, the catalogue is only downloaded again if it changed
+    if (updated && self->stats.failed == 0 && !vfr_provider_is_cancelled(self))
+        provider_save_remote(self);
+    vfr_provider_enforce_budget(self);
+
+    // Charts of removed cycles may have been the last users of some blobs
+    vfr_store_gc();
+
+    return updated;
+}
+
+// Statistics of the last synchronisation
+const VFRSyncStats *vfr_provider_get_sync_stats(VFRProvider *self)
+{
+    if (self)
+        return &self->stats;
+
+    return NULL;
+}
+
+/*
+ * Run the provider's needs_update and update_terrains callbacks in a
+ * worker thread. Those callbacks must not modify the terrains list of the
+ * provider: the updated list is written to disk, then loaded from the
+ * main thread once the synchronisation completes.
+ */
+void vfr_provider_sync_async(VFRProvider *self, GCancellable *cancellable,
+                             vfr_provider_progress_cb progress, vfr_provider_sync_cb callback,
+                             gpointer data)
+{
+    VFRProviderSync *sync;
+    GTask *task;
+
+    if (!self || self->sync)
+        return;
+
+    sync = g_malloc0(sizeof(VFRProviderSync));
+    sync->ref_count = 1;
+    sync->provider = self;
+    sync->context = g_main_context_ref_thread_default();
+    sync->progress = progress;
+    sync->callback = callback;
+    sync->data = data;
+
+    self->sync = sync;
+    if (cancellable)
+        self->cancellable = g_object_ref(cancellable);
+
+    task = g_task_new(NULL, cancellable, provider_sync_ready_cb, NULL);
+    g_task_set_task_data(task, sync, (GDestroyNotify)provider_sync_unref);
+    g_task_run_in_thread(task, provider_sync_thread);
+    g_object_unref(task);
+}
+
+gboolean vfr_provider_is_syncing(VFRProvider *self)
+{
+    return self && self->sync;
+}
+
+gboolean vfr_provider_is_cancelled(VFRProvider *self)
+{
+    if (self)
+        return g_cancellable_is_cancelled(self->cancellable);
+
+    return FALSE;
+}
+
+VFRDownloader *vfr_provider_create_downloader(VFRProvider *self, guint max_transfers)
+{
+    VFRDownloader *downloader = vfr_downloader_new(max_transfers);
+
+    if (self)
+        vfr_downloader_set_cancellable(downloader, self->cancellable);
+
+    return downloader;
+}
+
+/*
+ * Directory updates write to: the provider's data directory, or the one of
+ * the cycle being staged.
+ */
+static GString *provider_get_update_dir(VFRProvider *self)
+{
+    GString *dir = g_string_new(g_get_user_data_dir());
+
+    g_string_append_printf(dir, "/librevfr/%s", vfr_provider_get_id(self));
+    if (self->stage->len > 0) {
+        g_string_append_printf(dir, "/cycles/%s", self->stage->str);
+    } else {
+        g_string_append(dir, "/current");
+        if (!g_file_test(dir->str, G_FILE_TEST_IS_DIR))
+            g_string_truncate(dir, dir->len - strlen("/current"));
     }
-    free(line);
 
-    return TRUE;
+    return dir;
+}
+
+VFRManifest *vfr_provider_get_manifest(VFRProvider *self)
+{
+    GString *manifest_file;
+
+    if (!self)
+        return NULL;
+
+    if (!self->manifest) {
+        manifest_file = provider_get_update_dir(self);
+        g_string_append(manifest_file, "/manifest");
+        self->manifest = vfr_manifest_load(manifest_file->str);
+        g_string_free(manifest_file, TRUE);
+    }
+
+    return self->manifest;
+}
+
+/*
+ * Charts for the airfields of stored flights come first, then favourites,
+ * then the ones opened recently, most recent first.
+ */
+static gint64 provider_chart_priority(VFRProvider *self, const gchar *icao)
+{
+    gint64 priority = vfr_chart_cache_get_last_open(vfr_provider_get_id(self), icao);
+
+    if (vfr_flight_uses_airfield(icao))
+        priority += G_GINT64_CONSTANT(1) << 41;
+    if (vfr_provider_is_favorite(self, icao))
+        priority += G_GINT64_CONSTANT(1) << 40;
+
+    return priority;
+}
+
+/*
+ * Queue the chart for a terrain, sending the validators recorded in the
+ * manifest so that unchanged charts are answered with 304 Not Modified.
+ */
+VFRDownload *vfr_provider_queue_chart(VFRProvider *self, VFRDownloader *downloader,
+                                      VFRTerrain *terrain, const gchar *url)
+{
+    GString *vacfile;
+    VFRManifestEntry *entry;
+    VFRDownload *download;
+    gchar *key;
+
+    // Evicted charts are only fetched again when they are opened
+    if (vfr_chart_cache_is_evicted(vfr_provider_get_id(self), vfr_terrain_get_icao(terrain)))
+        return NULL;
+
+    vacfile = provider_get_update_dir(self);
+    g_string_append_printf(vacfile, "/files/%s.pdf", vfr_terrain_get_icao(terrain));
+
+    download = vfr_downloader_add(downloader, url, vacfile->str,
+                                  vfr_provider_download_done_cb, self);
+    vfr_download_set_priority(download,
+                              provider_chart_priority(self, vfr_terrain_get_icao(terrain)));
+    vfr_download_set_trailer(download, "%%EOF");
+
+    key = g_path_get_basename(vacfile->str);
+    entry = vfr_manifest_lookup(vfr_provider_get_manifest(self), key);
+
+    // Start a new cycle from the active one's chart, it's likely unchanged
+    if (!g_file_test(vacfile->str, G_FILE_TEST_EXISTS)) {
+        entry = vfr_manifest_lookup(self->seed, key);
+        if (entry && !vfr_store_link(entry->hash->str, vacfile->str))
+            entry = NULL;
+    }
+
+    if (entry && g_file_test(vacfile->str, G_FILE_TEST_EXISTS)) {
+        vfr_download_set_validators(download, entry->etag->str, entry->last_modified->str,
+                                    entry->hash->str);
+    }
+
+    g_free(key);
+    g_string_free(vacfile, TRUE);
+
+    if (download && self->sync) {
+        g_atomic_int_inc(&self->sync->total);
+        provider_sync_report(self->sync);
+    }
+
+    return download;
+}
+
+// Account a request made by the provider, for the running sync and overall
+void vfr_provider_record_request(VFRProvider *self, const gchar *url,
+                                 const VFRNetTiming *timing)
+{
+    if (!self || !timing)
+        return;
+
+    vfr_net_stats_add(&self->stats.net, timing);
+    vfr_net_record(vfr_provider_get_id(self), url, timing);
+}
+
+// Wait before the next attempt, unless the sync is cancelled meanwhile
+static gboolean provider_backoff(VFRProvider *self, guint attempt)
+{
+    gint64 end = g_get_monotonic_time() + vfr_net_get_backoff(attempt);
+
+    while (!vfr_provider_is_cancelled(self)) {
+        gint64 delay = end - g_get_monotonic_time();
+
+        if (delay <= 0)
+            return TRUE;
+        g_usleep(MIN(delay, 100 * G_TIME_SPAN_MILLISECOND));
+    }
+
+    return FALSE;
+}
+
+/*
+ * Perform a single (blocking) request with the providers' policy: timeouts,
+ * retries of transient failures and circuit breaker. As the response may be
+ * processed while it is received, `reset` is called before each new attempt.
+ */
+CURLcode vfr_provider_perform(VFRProvider *self, CURL *curl, const gchar *url,
+                              vfr_provider_reset_cb reset, gpointer data, glong *status)
+{
+    VFRNetTiming timing;
+    CURLcode res = CURLE_COULDNT_CONNECT;
+    glong code = 0;
+
+    vfr_net_policy_apply(curl);
+    curl_easy_setopt(curl, CURLOPT_URL, url);
+
+    for (guint attempt = 0; ; attempt++) {
+        if (!vfr_net_host_allowed(url)) {
+            printf("%s: server unavailable, skipping %s\n", vfr_provider_get_id(self), url);
+            res = CURLE_COULDNT_CONNECT;
+            code = 0;
+            break;
+        }
+
+        if (attempt > 0 && reset)
+            reset(data);
+
+        res = curl_easy_perform(curl);
+        code = 0;
+        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &code);
+        vfr_net_timing_init(&timing, curl, res);
+        vfr_provider_record_request(self, url, &timing);
+        vfr_net_host_report(url, res, code);
+
+        if (!vfr_net_is_transient(res, code) || attempt >= VFR_NET_MAX_RETRIES ||
+            !provider_backoff(self, attempt)) {
+            break;
+        }
+    }
+
+    if (status)
+        *status = code;
+
+    return res;
+}
+
+static size_t provider_probe_header_cb(char *buffer, size_t size, size_t nitems,
+                                       void *userdata)
+{
+    GString *etag = userdata;
+    size_t len = size * nitems;
+    gchar *line = g_strndup(buffer, len);
+    gchar *value = strchr(line, ':');
+
+    // Only keep the headers of the last response (e.g. after a redirect)
+    if (g_str_has_prefix(line, "HTTP/")) {
+        g_string_truncate(etag, 0);
+    } else if (value) {
+        *value++ = 0;
+        if (!g_ascii_strcasecmp(line, "ETag"))
+            g_string_assign(etag, g_strstrip(value));
+    }
+
+    g_free(line);
+
+    return len;
+}
+
+/*
+ * Cheaply identify the current version of a remote file, by only requesting
+ * its headers: the result is built from its ETag, or its modification time
+ * and size. NULL is returned if the file can't be identified this way, and
+ * `status` is set to the HTTP status of the response.
+ */
+gchar *vfr_provider_probe(VFRProvider *self, CURL *curl, const gchar *url, glong *status)
+{
+    GString *etag = g_string_new(NULL);
+    curl_off_t filetime = -1;
+    curl_off_t length = -1;
+    gchar *fingerprint = NULL;
+    glong code = 0;
+    CURLcode res;
+
+    curl_easy_setopt(curl, CURLOPT_NOBODY, 1L);
+    curl_easy_setopt(curl, CURLOPT_FILETIME, 1L);
+    curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, provider_probe_header_cb);
+    curl_easy_setopt(curl, CURLOPT_HEADERDATA, etag);
+    res = vfr_provider_perform(self, curl, url, NULL, NULL, &code);
+
+    if (res == CURLE_OK && code < 300) {
+        curl_easy_getinfo(curl, CURLINFO_FILETIME_T, &filetime);
+        curl_easy_getinfo(curl, CURLINFO_CONTENT_LENGTH_DOWNLOAD_T, &length);
+
+        // Weak ETags may be shared by different versions of a file
+        if (etag->len > 0 && !g_str_has_prefix(etag->str, "W/")) {
+            fingerprint = g_strdup_printf("etag %s", etag->str);
+        } else if (filetime >= 0) {
+            fingerprint = g_strdup_printf("time %" G_GINT64_FORMAT " %" G_GINT64_FORMAT,
+                                          (gint64)filetime, (gint64)length);
+        }
+    }
+
+    if (status)
+        *status = code;
+    g_string_free(etag, TRUE);
+
+    return fingerprint;
+}
+
+/*
+ * HTTP status of a remote file, only requesting its headers. It is probed
+ * once per sync: the status is kept until the next one starts, so that the
+ * provider's callbacks can all check it.
+ */
+glong vfr_provider_probe_status(VFRProvider *self, const gchar *url)
+{
+    gpointer status;
+    glong code = 0;
+    CURL *curl;
+
+    if (g_hash_table_lookup_extended(self->probed, url, NULL, &status))
+        return GPOINTER_TO_INT(status);
+
+    curl = curl_easy_init();
+    g_free(vfr_provider_probe(self, curl, url, &code));
+    curl_easy_cleanup(curl);
+
+    g_hash_table_insert(self->probed, g_strdup(url), GINT_TO_POINTER(code));
+
+    return code;
+}
+
+// Whether the remote catalogue was probed since the sync started
+gboolean vfr_provider_is_remote_known(VFRProvider *self)
+{
+    return self && self->remote->len > 0;
+}
+
+/*
+ * Compare the fingerprint of the remote catalogue (see vfr_provider_probe())
+ * with the one of the last successful update. An unknown (NULL) fingerprint
+ * is always considered as a change.
+ */
+gboolean vfr_provider_is_remote_changed(VFRProvider *self, const gchar *fingerprint)
+{
+    GString *filename;
+    gchar *contents = NULL;
+    gboolean changed;
+
+    if (!self || !fingerprint)
+        return TRUE;
+
+    filename = provider_get_remote_file(self);
+    changed = !g_file_get_contents(filename->str, &contents, NULL, NULL) ||
+              !g_str_equal(contents, fingerprint);
+    g_string_free(filename, TRUE);
+    g_free(contents);
+
+    g_string_assign(self->remote, fingerprint);
+
+    return changed;
+}
+
+void vfr_provider_download_done_cb(VFRDownload *download, gboolean success, gpointer data)
+{
+    VFRProvider *provider = data;
+    const VFRNetTiming *timings;
+    guint count;
+    gchar *key;
+
+    // Retried requests are accounted for each attempt
+    timings = vfr_download_get_timings(download, &count);
+    for (guint i = 0; i < count; i++)
+        vfr_provider_record_request(provider, vfr_download_get_url(download), &timings[i]);
+
+    if (provider->sync) {
+        g_atomic_int_inc(&provider->sync->done);
+        provider_sync_report(provider->sync);
+    }
+
+    if (!success) {
+        provider->stats.failed++;
+        printf("%s: unable to download %s (status %ld)\n", vfr_provider_get_id(provider),
+                                                           vfr_download_get_url(download),
+                                                           vfr_download_get_status(download));
+        return;
+    }
+
+    provider->stats.bytes += vfr_download_get_received(download);
+    if (vfr_download_is_modified(download))
+        provider->stats.downloaded++;
+    else
+        provider->stats.unchanged++;
+
+    vfr_store_add(vfr_download_get_filename(download), vfr_download_get_hash(download));
+
+    /*
+     * New validators may come with unchanged content: they must be saved,
+     * or every later sync would download the whole file again.
+     */
+    key = g_path_get_basename(vfr_download_get_filename(download));
+    if (vfr_download_get_status(download) != 304 ||
+        !vfr_manifest_lookup(vfr_provider_get_manifest(provider), key)) {
+        vfr_manifest_update(vfr_provider_get_manifest(provider), key,
+                            vfr_download_get_etag(download),
+                            vfr_download_get_last_modified(download),
+                            vfr_download_get_hash(download),
+                            vfr_download_get_size(download));
+    }
+    g_free(key);
+}
+
+gboolean vfr_provider_check_dirs(VFRProvider *self)
+{
+    GString *data_dir = g_string_new(g_get_user_data_dir());
+
+    g_string_append_printf(data_dir, "/librevfr/%s/files", vfr_provider_get_id(self));
+
+    if (g_access(data_dir->str, F_OK) < 0) {
+        g_mkdir_with_parents(data_dir->str, 0755);
+        g_string_free(data_dir, TRUE);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/*
+ * Providers publishing their charts by AIRAC cycle stage each cycle in its
+ * own directory, <id>/cycles/<airac>. The active cycle is selected by the
+ * <id>/current symbolic link, and the files and index paths used by readers
+ * point through it: a cycle is activated by atomically replacing this link,
+ * so readers see either the previous chart set or the new one, never a mix.
+ */
+static GString *provider_get_cycle_dir(VFRProvider *self, const gchar *cycle)
+{
+    GString *dir = g_string_new(g_get_user_data_dir());
+
+    g_string_append_printf(dir, "/librevfr/%s/cycles/%s", vfr_provider_get_id(self), cycle);
+
+    return dir;
+}
+
+static void provider_remove_tree(const gchar *path)
+{
+    GString *child = g_string_new(NULL);
+    const gchar *name;
+    GDir *dir;
+
+    dir = g_dir_open(path, 0, NULL);
+    while (dir && (name = g_dir_read_name(dir)) != NULL) {
+        g_string_printf(child, "%s/%s", path, name);
+        if (g_file_test(child->str, G_FILE_TEST_IS_DIR) &&
+            !g_file_test(child->str, G_FILE_TEST_IS_SYMLINK)) {
+            provider_remove_tree(child->str);
+        } else {
+            g_remove(child->str);
+        }
+    }
+
+    if (dir)
+        g_dir_close(dir);
+    g_rmdir(path);
+    g_string_free(child, TRUE);
+}
+
+// Redirect the update's downloads and index to a cycle's directory
+void vfr_provider_set_stage(VFRProvider *self, const gchar *cycle)
+{
+    GString *dir;
+
+    if (!self)
+        return;
+
+    // The manifest describes the files of the directory being updated
+    if (self->manifest) {
+        vfr_manifest_save(self->manifest);
+        vfr_manifest_free(self->manifest);
+        self->manifest = NULL;
+    }
+
+    if (self->seed) {
+        vfr_manifest_free(self->seed);
+        self->seed = NULL;
+    }
+
+    g_string_assign(self->stage, cycle ? cycle : "");
+
+    if (cycle) {
+        dir = provider_get_cycle_dir(self, cycle);
+        g_string_append(dir, "/files");
+        g_mkdir_with_parents(dir->str, 0755);
+        g_string_free(dir, TRUE);
+
+        // Charts of the active cycle can be reused through the store
+        dir = g_string_new(g_get_user_data_dir());
+        g_string_append_printf(dir, "/librevfr/%s/current/manifest", vfr_provider_get_id(self));
+        if (g_file_test(dir->str, G_FILE_TEST_EXISTS))
+            self->seed = vfr_manifest_load(dir->str);
+        g_string_free(dir, TRUE);
+    }
+}
+
+// Mark the cycle being staged as complete, so that it can be activated
+gboolean vfr_provider_commit_stage(VFRProvider *self)
+{
+    GString *marker;
+    gboolean result;
+
+    if (!self || self->stage->len == 0)
+        return FALSE;
+
+    marker = provider_get_cycle_dir(self, self->stage->str);
+    g_string_append(marker, "/complete");
+    result = g_file_set_contents(marker->str, "", 0, NULL);
+    g_string_free(marker, TRUE);
+
+    return result;
+}
+
+gboolean vfr_provider_is_cycle_staged(VFRProvider *self, const gchar *cycle)
+{
+    GString *marker;
+    gboolean result;
+
+    if (!self || !cycle)
+        return FALSE;
+
+    marker = provider_get_cycle_dir(self, cycle);
+    g_string_append(marker, "/complete");
+    result = g_file_test(marker->str, G_FILE_TEST_EXISTS);
+    g_string_free(marker, TRUE);
+
+    return result;
+}
+
+// Name of the active cycle, or NULL if none was activated yet
+gchar *vfr_provider_get_active_cycle(VFRProvider *self)
+{
+    GString *link = g_string_new(g_get_user_data_dir());
+    gchar *target;
+    gchar *cycle = NULL;
+
+    g_string_append_printf(link, "/librevfr/%s/current", vfr_provider_get_id(self));
+    target = g_file_read_link(link->str, NULL);
+    if (target) {
+        cycle = g_path_get_basename(target);
+        g_free(target);
+    }
+
+    g_string_free(link, TRUE);
+
+    return cycle;
+}
+
+// Make sure `name` is a link to `target`, moving away what was there before
+static gboolean provider_ensure_link(const gchar *dir, const gchar *name, const gchar *target,
+                                     const gchar *legacy)
+{
+    GString *path = g_string_new(dir);
+    GString *tmp = g_string_new(NULL);
+    gchar *current;
+    gboolean result = TRUE;
+
+    g_string_append_printf(path, "/%s", name);
+    current = g_file_read_link(path->str, NULL);
+    if (current && g_str_equal(current, target))
+        goto out;
+
+    // Files from before cycles were staged are removed with old cycles
+    if (!current && g_file_test(path->str, G_FILE_TEST_EXISTS)) {
+        g_mkdir_with_parents(legacy, 0755);
+        g_string_printf(tmp, "%s/%s", legacy, name);
+        g_rename(path->str, tmp->str);
+    }
+
+    g_string_printf(tmp, "%s.tmp", path->str);
+    g_remove(tmp->str);
+    result = symlink(target, tmp->str) == 0 && g_rename(tmp->str, path->str) == 0;
+
+out:
+    g_free(current);
+    g_string_free(tmp, TRUE);
+    g_string_free(path, TRUE);
+
+    return result;
+}
+
+/*
+ * Switch readers to a staged cycle. Its terrains are only shown once a new
+ * snapshot is loaded and published, see provider_sync_ready_cb().
+ */
+static gboolean provider_switch_cycle(VFRProvider *self, const gchar *cycle)
+{
+    GString *dir = g_string_new(g_get_user_data_dir());
+    GString *target = g_string_new("cycles/");
+    GString *legacy = provider_get_cycle_dir(self, "legacy");
+    gboolean result;
+
+    g_string_append_printf(dir, "/librevfr/%s", vfr_provider_get_id(self));
+    g_string_append(target, cycle);
+
+    result = provider_ensure_link(dir->str, "files", "current/files", legacy->str) &&
+             provider_ensure_link(dir->str, "index", "current/index", legacy->str) &&
+             provider_ensure_link(dir->str, "current", target->str, legacy->str);
+
+    g_string_free(legacy, TRUE);
+    g_string_free(target, TRUE);
+    g_string_free(dir, TRUE);
+
+    return result;
+}
+
+gboolean vfr_provider_activate_cycle(VFRProvider *self, const gchar *cycle)
+{
+    return vfr_provider_is_cycle_staged(self, cycle) && provider_switch_cycle(self, cycle);
+}
+
+/*
+ * When no cycle was ever activated, there's nothing better to show than the
+ * cycle being staged: activate it right away, so that its charts can be
+ * used as they arrive rather than once all of them are downloaded.
+ */
+gboolean vfr_provider_activate_stage(VFRProvider *self)
+{
+    gchar *active;
+    gboolean result = FALSE;
+
+    if (!self || self->stage->len == 0)
+        return FALSE;
+
+    active = vfr_provider_get_active_cycle(self);
+    if (!active)
+        result = provider_switch_cycle(self, self->stage->str);
+    g_free(active);
+
+    return result;
+}
+
+// Remove all staged cycles except the ones listed in `keep`
+void vfr_provider_prune_cycles(VFRProvider *self, const gchar * const *keep)
+{
+    GString *cycles = g_string_new(g_get_user_data_dir());
+    GString *path = g_string_new(NULL);
+    const gchar *name;
+    GDir *dir;
+
+    g_string_append_printf(cycles, "/librevfr/%s/cycles", vfr_provider_get_id(self));
+
+    dir = g_dir_open(cycles->str, 0, NULL);
+    while (dir && (name = g_dir_read_name(dir)) != NULL) {
+        if (g_strv_contains(keep, name))
+            continue;
+
+        g_string_printf(path, "%s/%s", cycles->str, name);
+        provider_remove_tree(path->str);
+    }
+
+    if (dir)
+        g_dir_close(dir);
+    g_string_free(path, TRUE);
+    g_string_free(cycles, TRUE);
+}
+
+typedef struct {
+    gchar *path;
+    gchar *icao;
+    gint64 last_open;
+} VFRChartCandidate;
+
+static void provider_chart_candidate_free(VFRChartCandidate *candidate)
+{
+    g_free(candidate->path);
+    g_free(candidate->icao);
+    g_free(candidate);
+}
+
+static gint provider_chart_candidate_compare(gconstpointer a, gconstpointer b)
+{
+    const VFRChartCandidate *ca = *(VFRChartCandidate **)a;
+    const VFRChartCandidate *cb = *(VFRChartCandidate **)b;
+
+    if (ca->last_open != cb->last_open)
+        return ca->last_open < cb->last_open ? -1 : 1;
+
+    return g_strcmp0(ca->icao, cb->icao);
+}
+
+// Favourites and the airfields of stored flights are never evicted
+static gboolean provider_chart_is_pinned(VFRProvider *self, const gchar *icao)
+{
+    return vfr_provider_is_favorite(self, icao) || vfr_flight_uses_airfield(icao);
+}
+
+static void provider_collect_charts(VFRProvider *self, const gchar *path, GPtrArray *charts)
+{
+    const gchar *name;
+    GDir *dir;
+
+    dir = g_dir_open(path, 0, NULL);
+    while (dir && (name = g_dir_read_name(dir)) != NULL) {
+        VFRChartCandidate *candidate;
+        gchar *icao;
+
+        if (!g_str_has_suffix(name, ".pdf"))
+            continue;
+
+        icao = g_strndup(name, strlen(name) - strlen(".pdf"));
+        if (provider_chart_is_pinned(self, icao)) {
+            g_free(icao);
+            continue;
+        }
+
+        candidate = g_malloc0(sizeof(VFRChartCandidate));
+        candidate->path = g_build_filename(path, name, NULL);
+        candidate->icao = icao;
+        candidate->last_open = vfr_chart_cache_get_last_open(vfr_provider_get_id(self), icao);
+        g_ptr_array_add(charts, candidate);
+    }
+
+    if (dir)
+        g_dir_close(dir);
+}
+
+/*
+ * Evict the provider's least recently opened charts until LibreVFR's data
+ * fits in the disk budget. This only considers the provider's own charts,
+ * as terrains of other providers may be reloaded concurrently.
+ */
+goffset vfr_provider_enforce_budget(VFRProvider *self)
+{
+    goffset budget = vfr_chart_cache_get_budget();
+    GPtrArray *charts;
+    GString *path;
+    const gchar *name;
+    goffset usage;
+    goffset freed = 0;
+    GDir *dir;
+
+    if (!self || budget <= 0)
+        return 0;
+
+    usage = vfr_chart_cache_get_usage();
+    if (usage <= budget)
+        return 0;
+
+    charts = g_ptr_array_new_with_free_func((GDestroyNotify)provider_chart_candidate_free);
+    path = g_string_new(g_get_user_data_dir());
+    g_string_append_printf(path, "/librevfr/%s/files", vfr_provider_get_id(self));
+    if (!g_file_test(path->str, G_FILE_TEST_IS_SYMLINK))
+        provider_collect_charts(self, path->str, charts);
+
+    g_string_printf(path, "%s/librevfr/%s/cycles", g_get_user_data_dir(),
+                                                  vfr_provider_get_id(self));
+    dir = g_dir_open(path->str, 0, NULL);
+    while (dir && (name = g_dir_read_name(dir)) != NULL) {
+        gchar *files = g_build_filename(path->str, name, "files", NULL);
+
+        provider_collect_charts(self, files, charts);
+        g_free(files);
+    }
+    if (dir)
+        g_dir_close(dir);
+
+    g_ptr_array_sort(charts, provider_chart_candidate_compare);
+
+    for (guint i = 0; i < charts->len && usage - freed > budget; i++) {
+        VFRChartCandidate *candidate = charts->pdata[i];
+        GStatBuf st;
+
+        if (g_stat(candidate->path, &st) < 0 || g_remove(candidate->path) < 0)
+            continue;
+
+        // Space is only reclaimed when no other file links to the same blob
+        if (st.st_nlink <= 2)
+            freed += st.st_size;
+        vfr_chart_cache_set_evicted(vfr_provider_get_id(self), candidate->icao);
+    }
+
+    vfr_chart_cache_save();
+    g_ptr_array_free(charts, TRUE);
+    g_string_free(path, TRUE);
+
+    return freed;
+}
+
+typedef struct {
+    VFRProvider *provider;
+    gchar *icao;
+    gchar *url;
+    gchar *filename;
+    gboolean success;
+    vfr_provider_fetch_cb callback;
+    gpointer data;
+} VFRProviderFetch;
+
+static void provider_fetch_free(VFRProviderFetch *fetch)
+{
+    g_free(fetch->icao);
+    g_free(fetch->url);
+    g_free(fetch->filename);
+    g_free(fetch);
+}
+
+static void provider_fetch_done_cb(VFRDownload *download, gboolean success, gpointer data)
+{
+    VFRProviderFetch *fetch = data;
+    const VFRNetTiming *timings;
+    guint count;
+
+    // Not part of a sync, only account it in the provider's overall stats
+    timings = vfr_download_get_timings(download, &count);
+    for (guint i = 0; i < count; i++) {
+        vfr_net_record(vfr_provider_get_id(fetch->provider), vfr_download_get_url(download),
+                       &timings[i]);
+    }
+
+    /*
+     * The downloader's result doesn't account for downloads which couldn't
+     * be started (e.g. the server is considered unavailable).
+     */
+    fetch->success = success;
+    if (success)
+        vfr_store_add(vfr_download_get_filename(download), vfr_download_get_hash(download));
+}
+
+static void provider_fetch_thread(GTask *task, gpointer source, gpointer task_data,
+                                  GCancellable *cancellable)
+{
+    VFRProviderFetch *fetch = task_data;
+    VFRDownloader *downloader = vfr_downloader_new(1);
+    VFRDownload *download;
+    gchar *partname;
+
+    vfr_downloader_set_cancellable(downloader, cancellable);
+    download = vfr_downloader_add(downloader, fetch->url, fetch->filename,
+                                  provider_fetch_done_cb, fetch);
+    vfr_download_set_trailer(download, "%%EOF");
+
+    /*
+     * While a sync is staging the active cycle, the same chart may be
+     * downloaded by it: both are received separately, then atomically
+     * renamed to the chart's file, so that it is always complete.
+     */
+    partname = g_strconcat(fetch->filename, ".fetch.part", NULL);
+    vfr_download_set_partname(download, partname);
+    g_free(partname);
+    vfr_downloader_run(downloader);
+    vfr_downloader_free(downloader);
+
+    g_task_return_boolean(task, fetch->success);
+}
+
+static void provider_fetch_ready_cb(GObject *source, GAsyncResult *result, gpointer data)
+{
+    VFRProviderFetch *fetch = g_task_get_task_data(G_TASK(result));
+    gboolean success = g_task_propagate_boolean(G_TASK(result), NULL);
+
+    if (fetch->callback)
+        fetch->callback(fetch->provider, fetch->icao, success, fetch->data);
+}
+
+/*
+ * Download a single chart (e.g. an evicted one) to the active chart set,
+ * independently of any running synchronisation.
+ */
+void vfr_provider_fetch_chart_async(VFRProvider *self, const gchar *icao,
+                                    GCancellable *cancellable, vfr_provider_fetch_cb callback,
+                                    gpointer data)
+{
+    VFRProviderFetch *fetch;
+    GString *filename;
+    GTask *task;
+
+    if (!self || !icao)
+        return;
+
+    fetch = g_malloc0(sizeof(VFRProviderFetch));
+    fetch->provider = self;
+    fetch->icao = g_strdup(icao);
+    fetch->url = vfr_provider_get_chart_url(self, icao, NULL);
+    fetch->callback = callback;
+    fetch->data = data;
+
+    filename = g_string_new(g_get_user_data_dir());
+    g_string_append_printf(filename, "/librevfr/%s/files/%s.pdf", vfr_provider_get_id(self), icao);
+    fetch->filename = g_string_free(filename, FALSE);
+
+    task = g_task_new(NULL, cancellable, provider_fetch_ready_cb, NULL);
+    g_task_set_task_data(task, fetch, (GDestroyNotify)provider_fetch_free);
+    if (fetch->url) {
+        g_task_run_in_thread(task, provider_fetch_thread);
+    } else {
+        g_task_return_boolean(task, FALSE);
+    }
+    g_object_unref(task);
+}
+
+gboolean vfr_provider_write_terrains(VFRProvider *self, GPtrArray *terrains)
+{
+    GString *data_index;
+    gboolean result;
+
+    if (!self || !terrains)
+        return FALSE;
+
+    data_index = provider_get_update_dir(self);
+
+    g_string_append(data_index, "/index");
+    result = vfr_terrain_index_write(data_index->str, terrains);
+    g_string_free(data_index, TRUE);
+
+    return result;
+}
+
+// Convert the semicolon-separated list used by earlier versions to an index
+static gboolean provider_convert_text_list(VFRProvider *self)
+{
+    GString *data_list = g_string_new(g_get_user_data_dir());
+    VFRTerrainArena *arena;
+    gboolean result;
+    char *line = NULL;
+    size_t size = 0;
+    gboolean favorite;
+    FILE *file;
+    int len;
+
+    g_string_append_printf(data_list, "/librevfr/%s/list", vfr_provider_get_id(self));
+    file = g_fopen(data_list->str, "r");
+    if (!file) {
+        g_string_free(data_list, TRUE);
+        return FALSE;
+    }
+
+    arena = vfr_terrain_arena_new();
+    while ((len = getline(&line, &size, file)) > 0) {
+        char **split;
+
+        if (line[len-1] == '\n')
+            line[len-1] = 0;
+        split = g_strsplit(line, ";", 0);
+        if (split && split[0] && split[1]) {
+            if (split[2] && split[2][0] == '1')
+                favorite = TRUE;
+            else
+                favorite = FALSE;
+            vfr_terrain_arena_add(arena, split[0], split[1], favorite);
+        }
+        g_strfreev(split);
+    }
+    free(line);
+    fclose(file);
+
+    result = vfr_provider_write_terrains(self, vfr_terrain_arena_get_terrains(arena));
+    if (result)
+        g_remove(data_list->str);
+    vfr_terrain_arena_free(arena);
+    g_string_free(data_list, TRUE);
+
+    return result;
+}
+
+// Build a new terrains list from the index file, from any thread
+static VFRTerrainSnapshot *provider_load_snapshot(VFRProvider *self)
+{
+    GString *data_index = g_string_new(g_get_user_data_dir());
+    VFRTerrainSnapshot *snapshot;
+
+    g_string_append_printf(data_index, "/librevfr/%s/index", vfr_provider_get_id(self));
+    snapshot = vfr_terrain_snapshot_load(data_index->str);
+    if (!snapshot && provider_convert_text_list(self))
+        snapshot = vfr_terrain_snapshot_load(data_index->str);
+    g_string_free(data_index, TRUE);
+
+    vfr_user_state_import_favorites(vfr_provider_get_id(self),
+                                    vfr_terrain_snapshot_get_terrains(snapshot));
+
+    return snapshot;
+}
+
+// Load the terrains list and switch to it, from the main thread
+gboolean vfr_provider_load_terrains(VFRProvider *self)
+{
+    VFRTerrainSnapshot *snapshot;
+
+    if (!self)
+        return FALSE;
+
+    snapshot = provider_load_snapshot(self);
+    provider_publish_snapshot(self, snapshot);
+
+    return snapshot != NULL;
 }
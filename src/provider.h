@@ -7,35 +7,105 @@
 #ifndef _VFR_PROVIDER_H
 #define _VFR_PROVIDER_H
 
-#include <glib.h>
+#include <gio/gio.h>
 
+#include "downloader.h"
+#include "manifest.h"
+#include "net-stats.h"
 #include "terrain.h"
+#include "terrain-snapshot.h"
 
 typedef struct _VFRProvider VFRProvider;
 
+typedef struct {
+    guint downloaded;
+    guint unchanged;
+    guint failed;
+    guint64 bytes;
+    VFRNetStats net;
+} VFRSyncStats;
+
 typedef gboolean (*vfr_provider_cb)(VFRProvider *provider);
+typedef void (*vfr_provider_progress_cb)(VFRProvider *provider, guint done, guint total,
+                                         gpointer data);
+typedef void (*vfr_provider_sync_cb)(VFRProvider *provider, gboolean updated, gpointer data);
+typedef void (*vfr_provider_fetch_cb)(VFRProvider *provider, const gchar *icao, gboolean success,
+                                      gpointer data);
+typedef void (*vfr_provider_reset_cb)(gpointer data);
+typedef gchar *(*vfr_provider_url_cb)(VFRProvider *provider, const gchar *icao,
+                                      const gchar *cycle);
 
 GPtrArray *vfr_provider_init(void);
+GPtrArray *vfr_provider_get_all(void);
 
 VFRProvider *vfr_provider_new(const gchar *name, const gchar *id);
 
 VFRProvider *vfr_provider_register(VFRProvider *provider);
+VFRProvider *vfr_provider_get_by_id(const gchar *id);
 
 const gchar *vfr_provider_get_name(VFRProvider *provider);
 const gchar *vfr_provider_get_id(VFRProvider *provider);
+const gchar *vfr_provider_get_base_url(VFRProvider *provider);
+void vfr_provider_set_base_url(VFRProvider *provider, const gchar *url);
 
 guint vfr_provider_get_terrain_count(VFRProvider *provider);
 VFRTerrain *vfr_provider_get_terrain_by_name(VFRProvider *provider, GString *name);
 VFRTerrain *vfr_provider_get_terrain_by_icao(VFRProvider *provider, GString *icao);
 VFRTerrain *vfr_provider_get_terrain_by_index(VFRProvider *provider, int index);
+GListModel *vfr_provider_get_model(VFRProvider *provider);
+
+VFRTerrain *vfr_provider_find_terrain_by_name(GString *name, VFRProvider **provider);
+VFRTerrain *vfr_provider_find_terrain_by_icao(GString *icao, VFRProvider **provider);
 
-void vfr_provider_add_terrain(VFRProvider *provider, VFRTerrain *terrain);
+VFRTerrainSnapshot *vfr_provider_peek_snapshot(VFRProvider *provider);
+VFRTerrainSnapshot *vfr_provider_get_snapshot(VFRProvider *provider);
+
+gboolean vfr_provider_is_favorite(VFRProvider *provider, const gchar *icao);
+gboolean vfr_provider_set_favorite(VFRProvider *provider, const gchar *icao, gboolean favorite);
 
 void vfr_provider_set_callbacks(VFRProvider *provider, vfr_provider_cb needs_update,
                                 vfr_provider_cb update_terrains);
+void vfr_provider_set_chart_url_func(VFRProvider *provider, vfr_provider_url_cb chart_url);
+gchar *vfr_provider_get_chart_url(VFRProvider *self, const gchar *icao, const gchar *cycle);
+
+VFRManifest *vfr_provider_get_manifest(VFRProvider *self);
+VFRDownload *vfr_provider_queue_chart(VFRProvider *self, VFRDownloader *downloader,
+                                      VFRTerrain *terrain, const gchar *url);
+void vfr_provider_record_request(VFRProvider *self, const gchar *url,
+                                 const VFRNetTiming *timing);
+CURLcode vfr_provider_perform(VFRProvider *self, CURL *curl, const gchar *url,
+                              vfr_provider_reset_cb reset, gpointer data, glong *status);
+gchar *vfr_provider_probe(VFRProvider *self, CURL *curl, const gchar *url, glong *status);
+glong vfr_provider_probe_status(VFRProvider *self, const gchar *url);
+gboolean vfr_provider_is_remote_changed(VFRProvider *self, const gchar *fingerprint);
+gboolean vfr_provider_is_remote_known(VFRProvider *self);
+void vfr_provider_download_done_cb(VFRDownload *download, gboolean success, gpointer data);
+
+gboolean vfr_provider_sync(VFRProvider *self, gboolean force);
+const VFRSyncStats *vfr_provider_get_sync_stats(VFRProvider *self);
+void vfr_provider_sync_async(VFRProvider *self, GCancellable *cancellable,
+                             vfr_provider_progress_cb progress, vfr_provider_sync_cb callback,
+                             gpointer data);
+gboolean vfr_provider_is_syncing(VFRProvider *self);
+gboolean vfr_provider_is_cancelled(VFRProvider *self);
+void vfr_provider_list_ready(VFRProvider *self);
+VFRDownloader *vfr_provider_create_downloader(VFRProvider *self, guint max_transfers);
+
+void vfr_provider_set_stage(VFRProvider *self, const gchar *cycle);
+gboolean vfr_provider_commit_stage(VFRProvider *self);
+gboolean vfr_provider_is_cycle_staged(VFRProvider *self, const gchar *cycle);
+gchar *vfr_provider_get_active_cycle(VFRProvider *self);
+gboolean vfr_provider_activate_cycle(VFRProvider *self, const gchar *cycle);
+gboolean vfr_provider_activate_stage(VFRProvider *self);
+void vfr_provider_prune_cycles(VFRProvider *self, const gchar * const *keep);
+
+goffset vfr_provider_enforce_budget(VFRProvider *self);
+void vfr_provider_fetch_chart_async(VFRProvider *self, const gchar *icao,
+                                    GCancellable *cancellable, vfr_provider_fetch_cb callback,
+                                    gpointer data);
 
 gboolean vfr_provider_check_dirs(VFRProvider *self);
-gboolean vfr_provider_write_list(VFRProvider *self);
+gboolean vfr_provider_write_terrains(VFRProvider *self, GPtrArray *terrains);
 gboolean vfr_provider_load_terrains(VFRProvider *self);
 
 #endif /* _VFR_PROVIDER_H */
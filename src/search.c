@@ -0,0 +1,236 @@
+/*
+ * (C) Copyright 2019, Arnaud Ferraris <arnaud.ferraris@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ */
+
+#include "search.h"
+
+#include "utils.h"
+
+#include <string.h>
+
+/*
+ * The search index is a sorted array of normalised keys: the ICAO code,
+ * the full name and each word of the name (pointing inside the full name).
+ * A prefix query is a binary search followed by a linear walk over the
+ * matching keys. When prefixes give too few results, names are scanned
+ * for the query characters in order (fuzzy match).
+ */
+
+typedef struct {
+    const gchar *key;
+    VFRTerrain *terrain;
+    VFRProvider *provider;
+    VFRSearchMatch match;
+} VFRSearchEntry;
+
+struct _VFRSearch {
+    // Terrains lists the entries point to
+    GPtrArray *snapshots;
+    GStringChunk *keys;
+    GArray *entries;
+    GArray *names;
+};
+
+static void search_add_entry(VFRSearch *self, const gchar *key, VFRTerrain *terrain,
+                             VFRProvider *provider, VFRSearchMatch match)
+{
+    VFRSearchEntry entry = { key, terrain, provider, match };
+
+    g_array_append_val(self->entries, entry);
+    if (match == VFR_SEARCH_MATCH_NAME_PREFIX)
+        g_array_append_val(self->names, entry);
+}
+
+static gboolean search_is_separator(gchar c)
+{
+    return c == ' ' || c == '-' || c == '\'' || c == '/' || c == '(';
+}
+
+static void search_add_terrain(VFRSearch *self, VFRTerrain *terrain, VFRProvider *provider)
+{
+    gchar *icao = vfr_normalize_string(vfr_terrain_get_icao(terrain));
+    gchar *name = vfr_normalize_string(vfr_terrain_get_name(terrain));
+    const gchar *key;
+
+    if (icao && *icao) {
+        key = g_string_chunk_insert_const(self->keys, icao);
+        search_add_entry(self, key, terrain, provider, VFR_SEARCH_MATCH_ICAO_PREFIX);
+    }
+
+    if (name && *name) {
+        key = g_string_chunk_insert(self->keys, name);
+        search_add_entry(self, key, terrain, provider, VFR_SEARCH_MATCH_NAME_PREFIX);
+
+        for (guint i = 1; key[i]; i++) {
+            if (search_is_separator(key[i-1]) && !search_is_separator(key[i]))
+                search_add_entry(self, key + i, terrain, provider, VFR_SEARCH_MATCH_WORD_PREFIX);
+        }
+    }
+
+    g_free(icao);
+    g_free(name);
+}
+
+static gint search_entry_compare(gconstpointer a, gconstpointer b)
+{
+    return strcmp(((const VFRSearchEntry *)a)->key, ((const VFRSearchEntry *)b)->key);
+}
+
+VFRSearch *vfr_search_new(GPtrArray *providers)
+{
+    VFRSearch *self = g_malloc0(sizeof(VFRSearch));
+    guint count = 0;
+
+    for (guint i = 0; providers && i < providers->len; i++)
+        count += vfr_provider_get_terrain_count(providers->pdata[i]);
+
+    self->keys = g_string_chunk_new(16 * 1024);
+    self->entries = g_array_sized_new(FALSE, FALSE, sizeof(VFRSearchEntry), count * 3);
+    self->names = g_array_sized_new(FALSE, FALSE, sizeof(VFRSearchEntry), count);
+
+    self->snapshots = g_ptr_array_new_with_free_func((GDestroyNotify)vfr_terrain_snapshot_unref);
+    for (guint i = 0; providers && i < providers->len; i++) {
+        VFRProvider *provider = providers->pdata[i];
+        VFRTerrainSnapshot *snapshot;
+
+        snapshot = vfr_terrain_snapshot_ref(vfr_provider_peek_snapshot(provider));
+
+        for (guint j = 0; j < vfr_terrain_snapshot_get_count(snapshot); j++)
+            search_add_terrain(self, vfr_terrain_snapshot_get(snapshot, j), provider);
+        if (snapshot)
+            g_ptr_array_add(self->snapshots, snapshot);
+    }
+
+    g_array_sort(self->entries, search_entry_compare);
+
+    return self;
+}
+
+void vfr_search_free(VFRSearch *self)
+{
+    if (!self)
+        return;
+
+    g_array_unref(self->entries);
+    g_array_unref(self->names);
+    g_string_chunk_free(self->keys);
+    g_ptr_array_free(self->snapshots, TRUE);
+    g_free(self);
+}
+
+static void search_add_result(GArray *results, GHashTable *seen, VFRSearchEntry *entry,
+                              VFRSearchMatch match)
+{
+    VFRSearchResult result = { entry->terrain, entry->provider, match };
+    gpointer index;
+
+    if (g_hash_table_lookup_extended(seen, entry->terrain, NULL, &index)) {
+        VFRSearchResult *previous = &g_array_index(results, VFRSearchResult,
+                                                   GPOINTER_TO_UINT(index));
+        if (match < previous->match)
+            previous->match = match;
+        return;
+    }
+
+    g_hash_table_insert(seen, entry->terrain, GUINT_TO_POINTER(results->len));
+    g_array_append_val(results, result);
+}
+
+static gboolean search_fuzzy_match(const gchar *key, const gchar *name)
+{
+    while (*key && *name) {
+        if (*key == *name)
+            key++;
+        name++;
+    }
+
+    return *key == 0;
+}
+
+static gint search_result_compare(gconstpointer a, gconstpointer b)
+{
+    const VFRSearchResult *ra = a;
+    const VFRSearchResult *rb = b;
+    const gchar *na = vfr_terrain_get_name(ra->terrain);
+    const gchar *nb = vfr_terrain_get_name(rb->terrain);
+    gsize la = strlen(na);
+    gsize lb = strlen(nb);
+
+    if (ra->match != rb->match)
+        return ra->match < rb->match ? -1 : 1;
+
+    // Shorter names are closer to the query
+    if (la != lb)
+        return la < lb ? -1 : 1;
+
+    return strcmp(na, nb);
+}
+
+/*
+ * Return at most `limit` VFRSearchResult items, best matches first.
+ */
+GArray *vfr_search_query(VFRSearch *self, const gchar *query, guint limit)
+{
+    GArray *results = g_array_new(FALSE, FALSE, sizeof(VFRSearchResult));
+    GHashTable *seen;
+    VFRSearchEntry *entries;
+    gchar *key;
+    gsize len;
+    guint low, high;
+
+    if (!self || !query)
+        return results;
+
+    key = g_strstrip(vfr_normalize_string(query));
+    len = strlen(key);
+    if (len == 0) {
+        g_free(key);
+        return results;
+    }
+
+    seen = g_hash_table_new(g_direct_hash, g_direct_equal);
+    entries = (VFRSearchEntry *)self->entries->data;
+
+    // Lower bound of the query in the sorted keys
+    low = 0;
+    high = self->entries->len;
+    while (low < high) {
+        guint mid = low + (high - low) / 2;
+
+        if (strcmp(entries[mid].key, key) < 0)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    for (guint i = low; i < self->entries->len && !strncmp(entries[i].key, key, len); i++) {
+        VFRSearchMatch match = entries[i].match;
+
+        if (match == VFR_SEARCH_MATCH_ICAO_PREFIX && entries[i].key[len] == 0)
+            match = VFR_SEARCH_MATCH_ICAO;
+
+        search_add_result(results, seen, &entries[i], match);
+    }
+
+    if (results->len < limit && len > 1) {
+        for (guint i = 0; i < self->names->len; i++) {
+            VFRSearchEntry *entry = &g_array_index(self->names, VFRSearchEntry, i);
+
+            if (!g_hash_table_contains(seen, entry->terrain) &&
+                search_fuzzy_match(key, entry->key)) {
+                search_add_result(results, seen, entry, VFR_SEARCH_MATCH_FUZZY);
+            }
+        }
+    }
+
+    g_array_sort(results, search_result_compare);
+    if (results->len > limit)
+        g_array_set_size(results, limit);
+
+    g_hash_table_destroy(seen);
+    g_free(key);
+
+    return results;
+}
@@ -0,0 +1,35 @@
+/*
+ * (C) Copyright 2019, Arnaud Ferraris <arnaud.ferraris@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ */
+
+#ifndef _VFR_SEARCH_H
+#define _VFR_SEARCH_H
+
+#include <glib.h>
+
+#include "provider.h"
+
+typedef struct _VFRSearch VFRSearch;
+
+typedef enum {
+    VFR_SEARCH_MATCH_ICAO = 0,
+    VFR_SEARCH_MATCH_ICAO_PREFIX,
+    VFR_SEARCH_MATCH_NAME_PREFIX,
+    VFR_SEARCH_MATCH_WORD_PREFIX,
+    VFR_SEARCH_MATCH_FUZZY,
+} VFRSearchMatch;
+
+typedef struct {
+    VFRTerrain *terrain;
+    VFRProvider *provider;
+    VFRSearchMatch match;
+} VFRSearchResult;
+
+VFRSearch *vfr_search_new(GPtrArray *providers);
+void vfr_search_free(VFRSearch *self);
+
+GArray *vfr_search_query(VFRSearch *self, const gchar *query, guint limit);
+
+#endif /* _VFR_SEARCH_H */
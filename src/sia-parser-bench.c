@@ -0,0 +1,187 @@
+/*
+ * (C) Copyright 2019, Arnaud Ferraris <arnaud.ferraris@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ */
+
+/*
+ * Standalone checks of the SIA terrains list tokenizer, built with
+ * `make sia-parser-bench` (add -fsanitize=address,undefined to CFLAGS to
+ * catch memory errors while fuzzing):
+ *
+ *   sia-parser-bench bench [ENTRIES] [ROUNDS]
+ *     time the parsing of a synthetic list, fed by 16 KiB chunks like curl
+ *     does (10000 entries by default)
+ *   sia-parser-bench fuzz [ROUNDS] [SEED]
+ *     feed randomly chunked, truncated and corrupted lists, checking that
+ *     intact ones are always parsed the same way
+ */
+
+#include "sia-parser.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BENCH_CHUNK_SIZE (16 * 1024)
+
+static GString *bench_make_list(guint entries)
+{
+    GString *list = g_string_new("var TabIcao = new Array(");
+
+    for (guint i = 0; i < entries; i++)
+        g_string_append_printf(list, "%s\"LF%04u\"", i ? "," : "", i);
+
+    g_string_append(list, ");\nvar TabNom = new Array(");
+    for (guint i = 0; i < entries; i++)
+        g_string_append_printf(list, "%s\"SAINT-TERRAIN %u DE L'ESSAI\"", i ? "," : "", i);
+    g_string_append(list, ");\n");
+
+    return list;
+}
+
+static void bench_feed(VFRSiaParser *parser, GRand *rand, const gchar *data, gsize len)
+{
+    while (len > 0) {
+        gsize chunk = rand ? (gsize)g_rand_int_range(rand, 1, 64) : BENCH_CHUNK_SIZE;
+
+        chunk = MIN(chunk, len);
+        vfr_sia_parser_feed(parser, data, chunk);
+        data += chunk;
+        len -= chunk;
+    }
+}
+
+static int bench_run(guint entries, guint rounds)
+{
+    GString *list = bench_make_list(entries);
+    VFRTerrainArena *arena = vfr_terrain_arena_new();
+    VFRSiaParser *parser = vfr_sia_parser_new(arena);
+    gint64 start;
+    gdouble elapsed;
+
+    rounds = MAX(rounds, 1);
+    start = g_get_monotonic_time();
+    for (guint i = 0; i < rounds; i++) {
+        vfr_sia_parser_reset(parser);
+        bench_feed(parser, NULL, list->str, list->len);
+    }
+
+    elapsed = (g_get_monotonic_time() - start) / (gdouble)G_USEC_PER_SEC;
+    if (vfr_terrain_arena_get_terrains(arena)->len != entries) {
+        printf("bench: %u terrains parsed out of %u\n",
+               vfr_terrain_arena_get_terrains(arena)->len, entries);
+        return 1;
+    }
+
+    printf("%u entries (%" G_GSIZE_FORMAT " bytes) x %u: %.2f ms per list, %.1f MiB/s\n",
+           entries, list->len, rounds, elapsed * 1000 / rounds,
+           list->len * (gdouble)rounds / elapsed / (1024 * 1024));
+
+    vfr_sia_parser_free(parser);
+    vfr_terrain_arena_free(arena);
+    g_string_free(list, TRUE);
+
+    return 0;
+}
+
+// Truncate the list, or overwrite some of its bytes with random ones
+static void fuzz_corrupt(GString *list, GRand *rand)
+{
+    const gchar special[] = { '"', '\n', '\0', ',', '\\', (gchar)0xc3, (gchar)0xff };
+
+    if (list->len == 0)
+        return;
+
+    if (g_rand_boolean(rand)) {
+        g_string_truncate(list, g_rand_int_range(rand, 0, list->len));
+        return;
+    }
+
+    for (gint i = g_rand_int_range(rand, 1, 16); i > 0; i--) {
+        gsize pos = g_rand_int_range(rand, 0, list->len);
+
+        if (g_rand_boolean(rand))
+            list->str[pos] = special[g_rand_int_range(rand, 0, sizeof(special))];
+        else
+            list->str[pos] = (gchar)g_rand_int_range(rand, 0, 256);
+    }
+}
+
+static gboolean fuzz_check(VFRSiaParser *parser, VFRTerrainArena *arena, gint expected)
+{
+    GPtrArray *terrains = vfr_terrain_arena_get_terrains(arena);
+    guint codes = vfr_sia_parser_get_codes(parser);
+    guint names = vfr_sia_parser_get_names(parser);
+
+    // Names without a matching code (or the opposite) are dropped
+    if (terrains->len != MIN(codes, names))
+        return FALSE;
+    if (expected >= 0 && terrains->len != (guint)expected)
+        return FALSE;
+
+    for (guint i = 0; i < terrains->len; i++) {
+        if (!vfr_terrain_get_name(terrains->pdata[i]) ||
+            !vfr_terrain_get_icao(terrains->pdata[i]))
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
+static int fuzz_run(guint rounds, guint32 seed)
+{
+    GRand *rand = g_rand_new_with_seed(seed);
+    VFRTerrainArena *arena = vfr_terrain_arena_new();
+    VFRSiaParser *parser = vfr_sia_parser_new(arena);
+    int result = 0;
+
+    for (guint i = 0; i < rounds && result == 0; i++) {
+        guint entries = g_rand_int_range(rand, 0, 200);
+        GString *list = bench_make_list(entries);
+
+        // Chunk boundaries must not change the result
+        vfr_sia_parser_reset(parser);
+        bench_feed(parser, rand, list->str, list->len);
+        if (!fuzz_check(parser, arena, entries)) {
+            printf("fuzz: intact list of %u entries misparsed (seed %u, round %u)\n",
+                   entries, seed, i);
+            result = 1;
+        }
+
+        fuzz_corrupt(list, rand);
+        vfr_sia_parser_reset(parser);
+        bench_feed(parser, rand, list->str, list->len);
+        if (result == 0 && !fuzz_check(parser, arena, -1)) {
+            printf("fuzz: inconsistent result for a corrupted list (seed %u, round %u)\n",
+                   seed, i);
+            result = 1;
+        }
+
+        g_string_free(list, TRUE);
+    }
+
+    if (result == 0)
+        printf("fuzz: %u rounds passed (seed %u)\n", rounds, seed);
+
+    vfr_sia_parser_free(parser);
+    vfr_terrain_arena_free(arena);
+    g_rand_free(rand);
+
+    return result;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc > 1 && g_str_equal(argv[1], "bench")) {
+        return bench_run(argc > 2 ? (guint)atoi(argv[2]) : 10000,
+                         argc > 3 ? (guint)atoi(argv[3]) : 20);
+    } else if (argc > 1 && g_str_equal(argv[1], "fuzz")) {
+        return fuzz_run(argc > 2 ? (guint)atoi(argv[2]) : 10000,
+                        argc > 3 ? (guint32)atol(argv[3]) : (guint32)g_get_real_time());
+    }
+
+    printf("usage: %s bench [ENTRIES] [ROUNDS] | fuzz [ROUNDS] [SEED]\n", argv[0]);
+
+    return 1;
+}
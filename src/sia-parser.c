@@ -0,0 +1,107 @@
+/*
+ * (C) Copyright 2019, Arnaud Ferraris <arnaud.ferraris@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ */
+
+#include "sia-parser.h"
+
+/*
+ * AeroArraysVac.js holds two JavaScript arrays of quoted strings, one per
+ * line: the ICAO codes first, then the names of the terrains in the same
+ * order. It is tokenized as it is received, so that neither the file nor
+ * its (very long) lines are ever stored entirely.
+ */
+struct _VFRSiaParser {
+    VFRTerrainArena *arena;
+    GPtrArray *icao;
+    GString *token;
+    guint line;
+    guint names;
+    gboolean quoted;
+};
+
+VFRSiaParser *vfr_sia_parser_new(VFRTerrainArena *arena)
+{
+    VFRSiaParser *parser = g_malloc0(sizeof(VFRSiaParser));
+
+    parser->arena = arena;
+    parser->icao = g_ptr_array_new();
+    parser->token = g_string_new(NULL);
+
+    return parser;
+}
+
+void vfr_sia_parser_free(VFRSiaParser *parser)
+{
+    if (!parser)
+        return;
+
+    g_ptr_array_free(parser->icao, TRUE);
+    g_string_free(parser->token, TRUE);
+    g_free(parser);
+}
+
+// Start over with an empty list, e.g. when the download is retried
+void vfr_sia_parser_reset(VFRSiaParser *parser)
+{
+    if (!parser)
+        return;
+
+    g_ptr_array_set_size(parser->icao, 0);
+    vfr_terrain_arena_clear(parser->arena);
+    g_string_truncate(parser->token, 0);
+    parser->line = 0;
+    parser->names = 0;
+    parser->quoted = FALSE;
+}
+
+static void sia_parser_add_name(VFRSiaParser *parser, gchar *name)
+{
+    // Names are all uppercase, only keep the first letter of each word
+    for (gsize i = 1; name[0] && name[i]; i++) {
+        if (g_ascii_isupper(name[i]) && name[i - 1] != ' ')
+            name[i] += 0x20;
+    }
+
+    if (parser->names < parser->icao->len)
+        vfr_terrain_arena_add(parser->arena, name, parser->icao->pdata[parser->names], FALSE);
+
+    parser->names++;
+}
+
+void vfr_sia_parser_feed(VFRSiaParser *parser, const gchar *data, gsize len)
+{
+    for (gsize i = 0; i < len && parser->line < 2; i++) {
+        gchar c = data[i];
+
+        if (c == '\n') {
+            // Strings never span several lines, drop any unterminated one
+            parser->quoted = FALSE;
+            parser->line++;
+        } else if (c == '"') {
+            parser->quoted = !parser->quoted;
+            if (parser->quoted) {
+                g_string_truncate(parser->token, 0);
+            } else if (parser->line == 0) {
+                g_ptr_array_add(parser->icao,
+                                (gpointer)vfr_terrain_arena_intern(parser->arena,
+                                                                   parser->token->str));
+            } else {
+                sia_parser_add_name(parser, parser->token->str);
+            }
+        } else if (parser->quoted) {
+            g_string_append_c(parser->token, c);
+        }
+    }
+}
+
+guint vfr_sia_parser_get_codes(VFRSiaParser *parser)
+{
+    return parser ? parser->icao->len : 0;
+}
+
+guint vfr_sia_parser_get_names(VFRSiaParser *parser)
+{
+    return parser ? parser->names : 0;
+}
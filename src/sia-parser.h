@@ -0,0 +1,24 @@
+/*
+ * (C) Copyright 2019, Arnaud Ferraris <arnaud.ferraris@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ */
+
+#ifndef _VFR_SIA_PARSER_H
+#define _VFR_SIA_PARSER_H
+
+#include <glib.h>
+
+#include "terrain-arena.h"
+
+typedef struct _VFRSiaParser VFRSiaParser;
+
+VFRSiaParser *vfr_sia_parser_new(VFRTerrainArena *arena);
+void vfr_sia_parser_free(VFRSiaParser *parser);
+void vfr_sia_parser_reset(VFRSiaParser *parser);
+
+void vfr_sia_parser_feed(VFRSiaParser *parser, const gchar *data, gsize len);
+guint vfr_sia_parser_get_codes(VFRSiaParser *parser);
+guint vfr_sia_parser_get_names(VFRSiaParser *parser);
+
+#endif /* _VFR_SIA_PARSER_H */
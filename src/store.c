@@ -0,0 +1,184 @@
+/*
+ * (C) Copyright 2019, Arnaud Ferraris <arnaud.ferraris@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ */
+
+#include "store.h"
+
+#include <string.h>
+#include <unistd.h>
+
+#include <glib/gstdio.h>
+
+/*
+ * Charts are stored once, in $XDG_DATA_HOME/librevfr/store, named after the
+ * SHA-256 of their content. The files of each provider and cycle are hard
+ * links to these blobs: identical charts cost no extra space, readers keep
+ * using the usual paths, and the link count of a blob is its reference
+ * count. Blobs are never modified in place, as downloads always replace
+ * files by renaming a new one over them.
+ *
+ * Providers sync concurrently: blobs are only added, linked and collected
+ * with `store_lock` held, so that a blob can't be removed (as unreferenced)
+ * while a new link to it is being created.
+ */
+
+static GMutex store_lock;
+
+static gchar *store_get_dir(void)
+{
+    return g_build_filename(g_get_user_data_dir(), "librevfr", "store", NULL);
+}
+
+static gboolean store_is_hash(const gchar *hash)
+{
+    if (!hash || strlen(hash) != 64)
+        return FALSE;
+
+    for (const gchar *p = hash; *p; p++) {
+        if (!g_ascii_isxdigit(*p))
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
+gchar *vfr_store_get_path(const gchar *hash)
+{
+    gchar *dir;
+    gchar *path;
+    gchar prefix[3] = { 0 };
+
+    if (!store_is_hash(hash))
+        return NULL;
+
+    memcpy(prefix, hash, 2);
+    dir = store_get_dir();
+    path = g_build_filename(dir, prefix, hash, NULL);
+    g_free(dir);
+
+    return path;
+}
+
+// Atomically replace `filename` by a new link to `blob`
+static gboolean store_replace_with_link(const gchar *blob, const gchar *filename)
+{
+    GString *tmp = g_string_new(filename);
+    gboolean result;
+
+    g_string_append(tmp, ".link");
+    g_remove(tmp->str);
+    result = link(blob, tmp->str) == 0 && g_rename(tmp->str, filename) == 0;
+    if (!result)
+        g_remove(tmp->str);
+
+    g_string_free(tmp, TRUE);
+
+    return result;
+}
+
+/*
+ * Move a file with the given hash into the store. If the same content was
+ * already stored, the file is replaced by a link to the existing blob.
+ */
+gboolean vfr_store_add(const gchar *filename, const gchar *hash)
+{
+    gchar *blob = vfr_store_get_path(hash);
+    gchar *dir;
+    GStatBuf blob_st;
+    GStatBuf file_st;
+    gboolean result;
+
+    if (!blob || g_stat(filename, &file_st) < 0) {
+        g_free(blob);
+        return FALSE;
+    }
+
+    g_mutex_lock(&store_lock);
+    if (g_stat(blob, &blob_st) == 0) {
+        result = (blob_st.st_dev == file_st.st_dev && blob_st.st_ino == file_st.st_ino) ||
+                 store_replace_with_link(blob, filename);
+    } else {
+        dir = g_path_get_dirname(blob);
+        g_mkdir_with_parents(dir, 0755);
+        g_free(dir);
+        result = link(filename, blob) == 0;
+    }
+    g_mutex_unlock(&store_lock);
+
+    g_free(blob);
+
+    return result;
+}
+
+// Create `filename` from a stored blob, without downloading it again
+gboolean vfr_store_link(const gchar *hash, const gchar *filename)
+{
+    gchar *blob = vfr_store_get_path(hash);
+    gboolean result;
+
+    g_mutex_lock(&store_lock);
+    result = blob && g_file_test(blob, G_FILE_TEST_EXISTS) &&
+             store_replace_with_link(blob, filename);
+    g_mutex_unlock(&store_lock);
+    g_free(blob);
+
+    return result;
+}
+
+// Number of files referencing a blob
+guint vfr_store_get_refcount(const gchar *hash)
+{
+    gchar *blob = vfr_store_get_path(hash);
+    GStatBuf st;
+    guint result = 0;
+
+    if (blob && g_stat(blob, &st) == 0 && st.st_nlink > 1)
+        result = st.st_nlink - 1;
+    g_free(blob);
+
+    return result;
+}
+
+/*
+ * Remove blobs which are no longer referenced by any file, and return the
+ * number of bytes freed.
+ */
+guint64 vfr_store_gc(void)
+{
+    gchar *root = store_get_dir();
+    GString *path = g_string_new(NULL);
+    const gchar *prefix;
+    const gchar *name;
+    guint64 freed = 0;
+    GDir *dir;
+    GDir *subdir;
+    GStatBuf st;
+
+    g_mutex_lock(&store_lock);
+    dir = g_dir_open(root, 0, NULL);
+    while (dir && (prefix = g_dir_read_name(dir)) != NULL) {
+        gchar *subpath = g_build_filename(root, prefix, NULL);
+
+        subdir = g_dir_open(subpath, 0, NULL);
+        while (subdir && (name = g_dir_read_name(subdir)) != NULL) {
+            g_string_printf(path, "%s/%s", subpath, name);
+            if (g_stat(path->str, &st) == 0 && st.st_nlink <= 1 && g_remove(path->str) == 0)
+                freed += st.st_size;
+        }
+
+        if (subdir)
+            g_dir_close(subdir);
+        g_rmdir(subpath);
+        g_free(subpath);
+    }
+
+    if (dir)
+        g_dir_close(dir);
+    g_mutex_unlock(&store_lock);
+    g_string_free(path, TRUE);
+    g_free(root);
+
+    return freed;
+}
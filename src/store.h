@@ -0,0 +1,20 @@
+/*
+ * (C) Copyright 2019, Arnaud Ferraris <arnaud.ferraris@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ */
+
+#ifndef _VFR_STORE_H
+#define _VFR_STORE_H
+
+#include <glib.h>
+
+gchar *vfr_store_get_path(const gchar *hash);
+
+gboolean vfr_store_add(const gchar *filename, const gchar *hash);
+gboolean vfr_store_link(const gchar *hash, const gchar *filename);
+guint vfr_store_get_refcount(const gchar *hash);
+
+guint64 vfr_store_gc(void);
+
+#endif /* _VFR_STORE_H */
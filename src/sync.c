@@ -0,0 +1,161 @@
+/*
+ * (C) Copyright 2019, Arnaud Ferraris <arnaud.ferraris@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ */
+
+#include "sync.h"
+
+#include "flight.h"
+#include "loader.h"
+#include "preview.h"
+#include "provider.h"
+
+#include <curl/curl.h>
+#include <evince-document.h>
+
+/*
+ * Headless synchronisation: update every provider (or only the ones given
+ * on the command line) without starting the UI, and print how long each
+ * step took. Base URLs can be overridden to benchmark against a mirror or
+ * a local server.
+ */
+
+static gboolean sync_mode = FALSE;
+static gboolean sync_force = FALSE;
+static gboolean sync_no_previews = FALSE;
+static gint sync_transfers = 0;
+static gchar **sync_base_urls = NULL;
+static gchar **sync_providers = NULL;
+
+static GOptionEntry sync_entries[] = {
+    { "sync", 0, G_OPTION_FLAG_HIDDEN, G_OPTION_ARG_NONE, &sync_mode,
+      NULL, NULL },
+    { "force", 'f', 0, G_OPTION_ARG_NONE, &sync_force,
+      "Update providers even if they are up to date", NULL },
+    { "no-previews", 0, 0, G_OPTION_ARG_NONE, &sync_no_previews,
+      "Don't render chart previews", NULL },
+    { "transfers", 't', 0, G_OPTION_ARG_INT, &sync_transfers,
+      "Number of parallel transfers", "N" },
+    { "base-url", 'b', 0, G_OPTION_ARG_STRING_ARRAY, &sync_base_urls,
+      "Override the base URL of a provider", "ID=URL" },
+    { G_OPTION_REMAINING, 0, 0, G_OPTION_ARG_STRING_ARRAY, &sync_providers,
+      NULL, "[PROVIDER...]" },
+    { NULL }
+};
+
+static gboolean sync_apply_base_urls(void)
+{
+    for (guint i = 0; sync_base_urls && sync_base_urls[i]; i++) {
+        gchar **parts = g_strsplit(sync_base_urls[i], "=", 2);
+        VFRProvider *provider = vfr_provider_get_by_id(parts[0]);
+
+        if (!provider || !parts[1]) {
+            fprintf(stderr, "Invalid base URL: %s\n", sync_base_urls[i]);
+            g_strfreev(parts);
+            return FALSE;
+        }
+
+        vfr_provider_set_base_url(provider, parts[1]);
+        g_strfreev(parts);
+    }
+
+    return TRUE;
+}
+
+static gboolean sync_is_selected(VFRProvider *provider)
+{
+    if (!sync_providers)
+        return TRUE;
+
+    return g_strv_contains((const gchar * const *)sync_providers,
+                           vfr_provider_get_id(provider));
+}
+
+static void sync_provider(VFRProvider *provider)
+{
+    const VFRSyncStats *stats;
+    gint64 start, synced, rendered;
+    gdouble elapsed, mib;
+    gboolean updated;
+
+    start = g_get_monotonic_time();
+    updated = vfr_provider_sync(provider, sync_force);
+    synced = g_get_monotonic_time();
+    if (updated && !sync_no_previews)
+        vfr_preview_render_provider(provider, NULL);
+    rendered = g_get_monotonic_time();
+
+    stats = vfr_provider_get_sync_stats(provider);
+    elapsed = (synced - start) / (gdouble)G_USEC_PER_SEC;
+    mib = stats->bytes / (1024.0 * 1024.0);
+
+    printf("%s: %s in %.2fs, %u downloaded, %u unchanged, %u failed, "
+           "%.1f MiB (%.2f MiB/s)",
+           vfr_provider_get_id(provider), updated ? "updated" : "up to date", elapsed,
+           stats->downloaded, stats->unchanged, stats->failed,
+           mib, elapsed > 0 ? mib / elapsed : 0);
+    if (rendered > synced)
+        printf(", previews in %.2fs", (rendered - synced) / (gdouble)G_USEC_PER_SEC);
+    printf("\n");
+
+    if (stats->net.requests > 0) {
+        const VFRNetStats *net = &stats->net;
+        gdouble n = net->requests;
+
+        printf("  %u requests (%u failed), average dns %.3fs, connect %.3fs, tls %.3fs, "
+               "ttfb %.3fs, transfer %.3fs, slowest %.2fs\n",
+               net->requests, net->failures, net->dns / n, net->connect / n, net->tls / n,
+               net->ttfb / n, net->transfer / n, net->slowest);
+    }
+}
+
+int vfr_sync_main(int argc, char *argv[])
+{
+    GOptionContext *context;
+    GPtrArray *providers;
+    GError *error = NULL;
+    gchar *transfers;
+    gint64 start;
+
+    context = g_option_context_new("- synchronise charts");
+    g_option_context_add_main_entries(context, sync_entries, NULL);
+    if (!g_option_context_parse(context, &argc, &argv, &error)) {
+        fprintf(stderr, "%s\n", error->message);
+        g_error_free(error);
+        g_option_context_free(context);
+        return 1;
+    }
+    g_option_context_free(context);
+
+    if (sync_transfers > 0) {
+        transfers = g_strdup_printf("%d", sync_transfers);
+        g_setenv("LIBREVFR_MAX_TRANSFERS", transfers, TRUE);
+        g_free(transfers);
+    }
+
+    // Not thread-safe, so done before the loaders start
+    curl_global_init(CURL_GLOBAL_DEFAULT);
+
+    // Airfields of stored flights must not be evicted from the disk cache
+    vfr_loader_start();
+    ev_init();
+    vfr_loader_wait(VFR_LOADER_FLIGHTS);
+    vfr_loader_wait(VFR_LOADER_PROVIDERS);
+    providers = vfr_provider_get_all();
+    if (!sync_apply_base_urls())
+        return 1;
+
+    start = g_get_monotonic_time();
+    for (guint i = 0; i < providers->len; i++) {
+        if (sync_is_selected(providers->pdata[i]))
+            sync_provider(providers->pdata[i]);
+    }
+    printf("Total: %.2fs\n", (g_get_monotonic_time() - start) / (gdouble)G_USEC_PER_SEC);
+
+    g_strfreev(sync_base_urls);
+    g_strfreev(sync_providers);
+    ev_shutdown();
+
+    return 0;
+}
@@ -0,0 +1,14 @@
+/*
+ * (C) Copyright 2019, Arnaud Ferraris <arnaud.ferraris@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ */
+
+#ifndef _VFR_SYNC_H
+#define _VFR_SYNC_H
+
+#include <glib.h>
+
+int vfr_sync_main(int argc, char *argv[]);
+
+#endif /* _VFR_SYNC_H */
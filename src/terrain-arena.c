@@ -0,0 +1,94 @@
+/*
+ * (C) Copyright 2019, Arnaud Ferraris <arnaud.ferraris@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ */
+
+#include "terrain-arena.h"
+
+/*
+ * Terrains are allocated by blocks of VFR_TERRAIN_ARENA_BLOCK_SIZE records,
+ * and their strings are interned in a single string chunk: a catalogue of
+ * thousands of terrains only takes a few allocations, and is released at
+ * once. Terrains and strings stay valid until the arena is cleared.
+ */
+struct _VFRTerrainArena {
+    GPtrArray *blocks;
+    guint used;
+    GStringChunk *strings;
+    GPtrArray *terrains;
+};
+
+VFRTerrainArena *vfr_terrain_arena_new(void)
+{
+    VFRTerrainArena *arena = g_malloc0(sizeof(VFRTerrainArena));
+
+    arena->blocks = g_ptr_array_new_with_free_func((GDestroyNotify)vfr_terrain_array_free);
+    arena->strings = g_string_chunk_new(64 * 1024);
+    arena->terrains = g_ptr_array_new();
+
+    return arena;
+}
+
+void vfr_terrain_arena_free(VFRTerrainArena *arena)
+{
+    if (!arena)
+        return;
+
+    g_ptr_array_free(arena->blocks, TRUE);
+    g_string_chunk_free(arena->strings);
+    g_ptr_array_free(arena->terrains, TRUE);
+    g_free(arena);
+}
+
+void vfr_terrain_arena_clear(VFRTerrainArena *arena)
+{
+    if (!arena)
+        return;
+
+    g_ptr_array_set_size(arena->blocks, 0);
+    arena->used = 0;
+    g_string_chunk_clear(arena->strings);
+    g_ptr_array_set_size(arena->terrains, 0);
+}
+
+// Identical strings are only stored once
+const gchar *vfr_terrain_arena_intern(VFRTerrainArena *arena, const gchar *str)
+{
+    if (!arena || !str)
+        return NULL;
+
+    return g_string_chunk_insert_const(arena->strings, str);
+}
+
+VFRTerrain *vfr_terrain_arena_add(VFRTerrainArena *arena, const gchar *name, const gchar *icao,
+                                  gboolean favorite)
+{
+    VFRTerrain *block;
+    VFRTerrain *terrain;
+
+    if (!arena)
+        return NULL;
+
+    if (arena->blocks->len == 0 || arena->used == VFR_TERRAIN_ARENA_BLOCK_SIZE) {
+        g_ptr_array_add(arena->blocks, vfr_terrain_array_new(VFR_TERRAIN_ARENA_BLOCK_SIZE));
+        arena->used = 0;
+    }
+
+    block = arena->blocks->pdata[arena->blocks->len - 1];
+    terrain = vfr_terrain_array_get(block, arena->used++);
+    vfr_terrain_init_static(terrain, vfr_terrain_arena_intern(arena, name ? name : ""),
+                            vfr_terrain_arena_intern(arena, icao ? icao : ""), favorite);
+    g_ptr_array_add(arena->terrains, terrain);
+
+    return terrain;
+}
+
+// Terrains of the arena, in the order they were added
+GPtrArray *vfr_terrain_arena_get_terrains(VFRTerrainArena *arena)
+{
+    if (arena)
+        return arena->terrains;
+
+    return NULL;
+}
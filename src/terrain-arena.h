@@ -0,0 +1,27 @@
+/*
+ * (C) Copyright 2019, Arnaud Ferraris <arnaud.ferraris@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ */
+
+#ifndef _VFR_TERRAIN_ARENA_H
+#define _VFR_TERRAIN_ARENA_H
+
+#include <glib.h>
+
+#include "terrain.h"
+
+#define VFR_TERRAIN_ARENA_BLOCK_SIZE 1024
+
+typedef struct _VFRTerrainArena VFRTerrainArena;
+
+VFRTerrainArena *vfr_terrain_arena_new(void);
+void vfr_terrain_arena_free(VFRTerrainArena *arena);
+void vfr_terrain_arena_clear(VFRTerrainArena *arena);
+
+const gchar *vfr_terrain_arena_intern(VFRTerrainArena *arena, const gchar *str);
+VFRTerrain *vfr_terrain_arena_add(VFRTerrainArena *arena, const gchar *name, const gchar *icao,
+                                  gboolean favorite);
+GPtrArray *vfr_terrain_arena_get_terrains(VFRTerrainArena *arena);
+
+#endif /* _VFR_TERRAIN_ARENA_H */
@@ -0,0 +1,185 @@
+/*
+ * (C) Copyright 2019, Arnaud Ferraris <arnaud.ferraris@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ */
+
+#include "terrain-index.h"
+
+#include <string.h>
+
+/*
+ * Index file layout, all integers being little-endian:
+ *   - header
+ *   - one fixed-size record per terrain
+ *   - string table (NUL-terminated strings referenced by offset)
+ * The file is mapped read-only and strings are used in place.
+ */
+
+#define INDEX_MAGIC "VFRI"
+
+#define INDEX_FLAG_FAVORITE (1 << 0)
+
+typedef struct {
+    gchar magic[4];
+    guint32 version;
+    guint32 count;
+    guint32 strings_offset;
+    guint32 strings_size;
+} VFRIndexHeader;
+
+typedef struct {
+    guint32 name;
+    guint32 icao;
+    guint32 flags;
+} VFRIndexRecord;
+
+struct _VFRTerrainIndex {
+    GMappedFile *file;
+    VFRTerrain *terrains;
+    guint count;
+};
+
+static guint32 index_add_string(GByteArray *strings, const gchar *str)
+{
+    guint32 offset = strings->len;
+
+    if (!str)
+        str = "";
+
+    g_byte_array_append(strings, (const guint8 *)str, strlen(str) + 1);
+
+    return offset;
+}
+
+gboolean vfr_terrain_index_write(const gchar *filename, GPtrArray *terrains)
+{
+    GByteArray *strings = g_byte_array_new();
+    VFRIndexRecord *records = g_new0(VFRIndexRecord, terrains->len);
+    VFRIndexHeader header;
+    GByteArray *data;
+    gboolean result;
+
+    for (guint i = 0; i < terrains->len; i++) {
+        VFRTerrain *terrain = terrains->pdata[i];
+
+        records[i].name = GUINT32_TO_LE(index_add_string(strings, vfr_terrain_get_name(terrain)));
+        records[i].icao = GUINT32_TO_LE(index_add_string(strings, vfr_terrain_get_icao(terrain)));
+        records[i].flags = GUINT32_TO_LE(vfr_terrain_is_favorite(terrain) ? INDEX_FLAG_FAVORITE : 0);
+    }
+
+    memcpy(header.magic, INDEX_MAGIC, 4);
+    header.version = GUINT32_TO_LE(VFR_TERRAIN_INDEX_VERSION);
+    header.count = GUINT32_TO_LE(terrains->len);
+    header.strings_offset = GUINT32_TO_LE(sizeof(header) + terrains->len * sizeof(VFRIndexRecord));
+    header.strings_size = GUINT32_TO_LE(strings->len);
+
+    data = g_byte_array_sized_new(sizeof(header) + terrains->len * sizeof(VFRIndexRecord) +
+                                  strings->len);
+    g_byte_array_append(data, (const guint8 *)&header, sizeof(header));
+    g_byte_array_append(data, (const guint8 *)records, terrains->len * sizeof(VFRIndexRecord));
+    g_byte_array_append(data, strings->data, strings->len);
+
+    /*
+     * The file is replaced atomically, so that a previous version which is
+     * still mapped remains valid.
+     */
+    result = g_file_set_contents(filename, (const gchar *)data->data, data->len, NULL);
+
+    g_byte_array_unref(data);
+    g_byte_array_unref(strings);
+    g_free(records);
+
+    return result;
+}
+
+VFRTerrainIndex *vfr_terrain_index_open(const gchar *filename)
+{
+    VFRTerrainIndex *index;
+    const VFRIndexHeader *header;
+    const VFRIndexRecord *records;
+    const gchar *strings;
+    GMappedFile *file;
+    gsize size;
+    guint32 count, strings_offset, strings_size;
+
+    file = g_mapped_file_new(filename, FALSE, NULL);
+    if (!file)
+        return NULL;
+
+    size = g_mapped_file_get_length(file);
+    header = (const VFRIndexHeader *)g_mapped_file_get_contents(file);
+    if (size < sizeof(VFRIndexHeader) || memcmp(header->magic, INDEX_MAGIC, 4) != 0 ||
+        GUINT32_FROM_LE(header->version) != VFR_TERRAIN_INDEX_VERSION) {
+        goto invalid;
+    }
+
+    count = GUINT32_FROM_LE(header->count);
+    strings_offset = GUINT32_FROM_LE(header->strings_offset);
+    strings_size = GUINT32_FROM_LE(header->strings_size);
+
+    if ((gsize)count > (size - sizeof(VFRIndexHeader)) / sizeof(VFRIndexRecord) ||
+        strings_offset != sizeof(VFRIndexHeader) + count * sizeof(VFRIndexRecord) ||
+        (gsize)strings_offset + strings_size > size) {
+        goto invalid;
+    }
+
+    records = (const VFRIndexRecord *)(header + 1);
+    strings = (const gchar *)header + strings_offset;
+
+    // All strings must be terminated inside the string table
+    if (count > 0 && (strings_size == 0 || strings[strings_size - 1] != 0))
+        goto invalid;
+
+    index = g_malloc0(sizeof(VFRTerrainIndex));
+    index->file = file;
+    index->count = count;
+    index->terrains = vfr_terrain_array_new(count);
+
+    for (guint i = 0; i < count; i++) {
+        guint32 name = GUINT32_FROM_LE(records[i].name);
+        guint32 icao = GUINT32_FROM_LE(records[i].icao);
+        guint32 flags = GUINT32_FROM_LE(records[i].flags);
+
+        if (name >= strings_size || icao >= strings_size) {
+            vfr_terrain_index_close(index);
+            return NULL;
+        }
+
+        vfr_terrain_init_static(vfr_terrain_array_get(index->terrains, i),
+                                strings + name, strings + icao,
+                                (flags & INDEX_FLAG_FAVORITE) != 0);
+    }
+
+    return index;
+
+invalid:
+    g_mapped_file_unref(file);
+    return NULL;
+}
+
+void vfr_terrain_index_close(VFRTerrainIndex *index)
+{
+    if (!index)
+        return;
+
+    vfr_terrain_array_free(index->terrains);
+    g_mapped_file_unref(index->file);
+    g_free(index);
+}
+
+guint vfr_terrain_index_get_count(VFRTerrainIndex *index)
+{
+    if (index)
+        return index->count;
+
+    return 0;
+}
+
+VFRTerrain *vfr_terrain_index_get(VFRTerrainIndex *index, guint i)
+{
+    if (index && i < index->count)
+        return vfr_terrain_array_get(index->terrains, i);
+
+    return NULL;
+}
@@ -0,0 +1,26 @@
+/*
+ * (C) Copyright 2019, Arnaud Ferraris <arnaud.ferraris@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ */
+
+#ifndef _VFR_TERRAIN_INDEX_H
+#define _VFR_TERRAIN_INDEX_H
+
+#include <glib.h>
+
+#include "terrain.h"
+
+#define VFR_TERRAIN_INDEX_VERSION 1
+
+typedef struct _VFRTerrainIndex VFRTerrainIndex;
+
+gboolean vfr_terrain_index_write(const gchar *filename, GPtrArray *terrains);
+
+VFRTerrainIndex *vfr_terrain_index_open(const gchar *filename);
+void vfr_terrain_index_close(VFRTerrainIndex *index);
+
+guint vfr_terrain_index_get_count(VFRTerrainIndex *index);
+VFRTerrain *vfr_terrain_index_get(VFRTerrainIndex *index, guint i);
+
+#endif /* _VFR_TERRAIN_INDEX_H */
@@ -0,0 +1,157 @@
+/*
+ * (C) Copyright 2019, Arnaud Ferraris <arnaud.ferraris@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ */
+
+#include "terrain-list.h"
+
+/*
+ * VFRTerrainList exposes a provider's terrains as a GListModel. Items are
+ * only created when requested, and only the first `limit` terrains are
+ * exposed: GtkListBox creates a row for every item of its model, so views
+ * grow the limit as the user scrolls instead of binding thousands of rows.
+ */
+
+struct _VFRTerrainItem {
+    GObject parent_instance;
+
+    // Keeps the terrain valid if the provider switches to a new list
+    VFRTerrainSnapshot *snapshot;
+    VFRTerrain *terrain;
+};
+
+G_DEFINE_TYPE(VFRTerrainItem, vfr_terrain_item, G_TYPE_OBJECT)
+
+static void vfr_terrain_item_finalize(GObject *object)
+{
+    VFRTerrainItem *self = VFR_TERRAIN_ITEM(object);
+
+    vfr_terrain_snapshot_unref(self->snapshot);
+
+    G_OBJECT_CLASS(vfr_terrain_item_parent_class)->finalize(object);
+}
+
+static void vfr_terrain_item_class_init(VFRTerrainItemClass *klass)
+{
+    G_OBJECT_CLASS(klass)->finalize = vfr_terrain_item_finalize;
+}
+
+static void vfr_terrain_item_init(VFRTerrainItem *self)
+{
+}
+
+VFRTerrain *vfr_terrain_item_get_terrain(VFRTerrainItem *item)
+{
+    if (item)
+        return item->terrain;
+
+    return NULL;
+}
+
+struct _VFRTerrainList {
+    GObject parent_instance;
+
+    VFRProvider *provider;
+    guint limit;
+    guint n_items;
+};
+
+static void vfr_terrain_list_model_init(GListModelInterface *iface);
+
+G_DEFINE_TYPE_WITH_CODE(VFRTerrainList, vfr_terrain_list, G_TYPE_OBJECT,
+                        G_IMPLEMENT_INTERFACE(G_TYPE_LIST_MODEL, vfr_terrain_list_model_init))
+
+static guint terrain_list_count(VFRTerrainList *self)
+{
+    return MIN(vfr_provider_get_terrain_count(self->provider), self->limit);
+}
+
+static GType terrain_list_get_item_type(GListModel *list)
+{
+    return VFR_TYPE_TERRAIN_ITEM;
+}
+
+static guint terrain_list_get_n_items(GListModel *list)
+{
+    return VFR_TERRAIN_LIST(list)->n_items;
+}
+
+static gpointer terrain_list_get_item(GListModel *list, guint position)
+{
+    VFRTerrainList *self = VFR_TERRAIN_LIST(list);
+    VFRTerrainItem *item;
+
+    if (position >= self->n_items)
+        return NULL;
+
+    item = g_object_new(VFR_TYPE_TERRAIN_ITEM, NULL);
+    item->snapshot = vfr_terrain_snapshot_ref(vfr_provider_peek_snapshot(self->provider));
+    item->terrain = vfr_terrain_snapshot_get(item->snapshot, position);
+
+    return item;
+}
+
+static void vfr_terrain_list_model_init(GListModelInterface *iface)
+{
+    iface->get_item_type = terrain_list_get_item_type;
+    iface->get_n_items = terrain_list_get_n_items;
+    iface->get_item = terrain_list_get_item;
+}
+
+static void vfr_terrain_list_class_init(VFRTerrainListClass *klass)
+{
+}
+
+static void vfr_terrain_list_init(VFRTerrainList *self)
+{
+    self->limit = G_MAXUINT;
+}
+
+VFRTerrainList *vfr_terrain_list_new(VFRProvider *provider)
+{
+    VFRTerrainList *self = g_object_new(VFR_TYPE_TERRAIN_LIST, NULL);
+
+    self->provider = provider;
+    self->n_items = terrain_list_count(self);
+
+    return self;
+}
+
+void vfr_terrain_list_set_limit(VFRTerrainList *self, guint limit)
+{
+    guint previous;
+
+    if (!self || limit == self->limit)
+        return;
+
+    previous = self->n_items;
+    self->limit = limit;
+    self->n_items = terrain_list_count(self);
+
+    if (self->n_items > previous)
+        g_list_model_items_changed(G_LIST_MODEL(self), previous, 0, self->n_items - previous);
+    else if (self->n_items < previous)
+        g_list_model_items_changed(G_LIST_MODEL(self), self->n_items, previous - self->n_items, 0);
+}
+
+guint vfr_terrain_list_get_limit(VFRTerrainList *self)
+{
+    if (self)
+        return self->limit;
+
+    return 0;
+}
+
+// Must be called whenever the provider's terrains are reloaded
+void vfr_terrain_list_refresh(VFRTerrainList *self)
+{
+    guint previous;
+
+    if (!self)
+        return;
+
+    previous = self->n_items;
+    self->n_items = terrain_list_count(self);
+    g_list_model_items_changed(G_LIST_MODEL(self), 0, previous, self->n_items);
+}
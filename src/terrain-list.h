@@ -0,0 +1,34 @@
+/*
+ * (C) Copyright 2019, Arnaud Ferraris <arnaud.ferraris@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ */
+
+#ifndef _VFR_TERRAIN_LIST_H
+#define _VFR_TERRAIN_LIST_H
+
+#include <gio/gio.h>
+
+#include "provider.h"
+
+G_BEGIN_DECLS
+
+#define VFR_TYPE_TERRAIN_ITEM (vfr_terrain_item_get_type())
+
+G_DECLARE_FINAL_TYPE(VFRTerrainItem, vfr_terrain_item, VFR, TERRAIN_ITEM, GObject)
+
+VFRTerrain *vfr_terrain_item_get_terrain(VFRTerrainItem *item);
+
+#define VFR_TYPE_TERRAIN_LIST (vfr_terrain_list_get_type())
+
+G_DECLARE_FINAL_TYPE(VFRTerrainList, vfr_terrain_list, VFR, TERRAIN_LIST, GObject)
+
+VFRTerrainList *vfr_terrain_list_new(VFRProvider *provider);
+
+void vfr_terrain_list_set_limit(VFRTerrainList *self, guint limit);
+guint vfr_terrain_list_get_limit(VFRTerrainList *self);
+void vfr_terrain_list_refresh(VFRTerrainList *self);
+
+G_END_DECLS
+
+#endif /* _VFR_TERRAIN_LIST_H */
@@ -0,0 +1,152 @@
+/*
+ * (C) Copyright 2019, Arnaud Ferraris <arnaud.ferraris@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ */
+
+#include "terrain-snapshot.h"
+
+#include "terrain-arena.h"
+#include "terrain-index.h"
+#include "utils.h"
+
+/*
+ * A snapshot is a complete terrains list along with its lookup tables. It
+ * is built at once (possibly from a worker thread) and never modified
+ * afterwards: a provider publishes a new snapshot rather than updating the
+ * current one. Terrains remain valid as long as a reference to their
+ * snapshot is held.
+ */
+struct _VFRTerrainSnapshot {
+    gint ref_count;
+
+    VFRTerrainIndex *index;
+    GPtrArray *terrains;
+    GHashTable *by_icao;
+    GHashTable *by_name;
+
+    // Normalised names used as lookup keys
+    VFRTerrainArena *keys;
+};
+
+// ICAO codes are compared case-insensitively, without copying them
+static guint snapshot_icao_hash(gconstpointer key)
+{
+    guint hash = 5381;
+
+    for (const gchar *p = key; *p; p++)
+        hash = (hash << 5) + hash + g_ascii_toupper(*p);
+
+    return hash;
+}
+
+static gboolean snapshot_icao_equal(gconstpointer a, gconstpointer b)
+{
+    return g_ascii_strcasecmp(a, b) == 0;
+}
+
+static void snapshot_add_terrain(VFRTerrainSnapshot *snapshot, VFRTerrain *terrain)
+{
+    const gchar *icao = vfr_terrain_get_icao(terrain);
+    gchar *name = vfr_normalize_string(vfr_terrain_get_name(terrain));
+
+    g_ptr_array_add(snapshot->terrains, terrain);
+
+    // Keep the first terrain in case of duplicates
+    if (icao && !g_hash_table_contains(snapshot->by_icao, icao))
+        g_hash_table_insert(snapshot->by_icao, (gpointer)icao, terrain);
+
+    if (name && !g_hash_table_contains(snapshot->by_name, name)) {
+        g_hash_table_insert(snapshot->by_name,
+                            (gpointer)vfr_terrain_arena_intern(snapshot->keys, name), terrain);
+    }
+    g_free(name);
+}
+
+// Returns NULL if there is no valid index file
+VFRTerrainSnapshot *vfr_terrain_snapshot_load(const gchar *filename)
+{
+    VFRTerrainIndex *index = vfr_terrain_index_open(filename);
+    VFRTerrainSnapshot *snapshot;
+    guint count;
+
+    if (!index)
+        return NULL;
+
+    count = vfr_terrain_index_get_count(index);
+
+    snapshot = g_malloc0(sizeof(VFRTerrainSnapshot));
+    snapshot->ref_count = 1;
+    snapshot->index = index;
+    snapshot->terrains = g_ptr_array_sized_new(count);
+    snapshot->by_icao = g_hash_table_new(snapshot_icao_hash, snapshot_icao_equal);
+    snapshot->by_name = g_hash_table_new(g_str_hash, g_str_equal);
+    snapshot->keys = vfr_terrain_arena_new();
+
+    for (guint i = 0; i < count; i++)
+        snapshot_add_terrain(snapshot, vfr_terrain_index_get(index, i));
+
+    return snapshot;
+}
+
+VFRTerrainSnapshot *vfr_terrain_snapshot_ref(VFRTerrainSnapshot *snapshot)
+{
+    if (snapshot)
+        g_atomic_int_inc(&snapshot->ref_count);
+
+    return snapshot;
+}
+
+void vfr_terrain_snapshot_unref(VFRTerrainSnapshot *snapshot)
+{
+    if (!snapshot || !g_atomic_int_dec_and_test(&snapshot->ref_count))
+        return;
+
+    g_hash_table_destroy(snapshot->by_icao);
+    g_hash_table_destroy(snapshot->by_name);
+    g_ptr_array_free(snapshot->terrains, TRUE);
+    vfr_terrain_arena_free(snapshot->keys);
+    vfr_terrain_index_close(snapshot->index);
+    g_free(snapshot);
+}
+
+guint vfr_terrain_snapshot_get_count(VFRTerrainSnapshot *snapshot)
+{
+    if (snapshot)
+        return snapshot->terrains->len;
+
+    return 0;
+}
+
+VFRTerrain *vfr_terrain_snapshot_get(VFRTerrainSnapshot *snapshot, guint index)
+{
+    if (snapshot && index < snapshot->terrains->len)
+        return snapshot->terrains->pdata[index];
+
+    return NULL;
+}
+
+GPtrArray *vfr_terrain_snapshot_get_terrains(VFRTerrainSnapshot *snapshot)
+{
+    if (snapshot)
+        return snapshot->terrains;
+
+    return NULL;
+}
+
+VFRTerrain *vfr_terrain_snapshot_lookup_icao(VFRTerrainSnapshot *snapshot, const gchar *icao)
+{
+    if (snapshot && icao)
+        return g_hash_table_lookup(snapshot->by_icao, icao);
+
+    return NULL;
+}
+
+// `key` is a name normalised with vfr_normalize_string()
+VFRTerrain *vfr_terrain_snapshot_lookup_name(VFRTerrainSnapshot *snapshot, const gchar *key)
+{
+    if (snapshot && key)
+        return g_hash_table_lookup(snapshot->by_name, key);
+
+    return NULL;
+}
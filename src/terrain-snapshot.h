@@ -0,0 +1,26 @@
+/*
+ * (C) Copyright 2019, Arnaud Ferraris <arnaud.ferraris@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ */
+
+#ifndef _VFR_TERRAIN_SNAPSHOT_H
+#define _VFR_TERRAIN_SNAPSHOT_H
+
+#include <glib.h>
+
+#include "terrain.h"
+
+typedef struct _VFRTerrainSnapshot VFRTerrainSnapshot;
+
+VFRTerrainSnapshot *vfr_terrain_snapshot_load(const gchar *filename);
+VFRTerrainSnapshot *vfr_terrain_snapshot_ref(VFRTerrainSnapshot *snapshot);
+void vfr_terrain_snapshot_unref(VFRTerrainSnapshot *snapshot);
+
+guint vfr_terrain_snapshot_get_count(VFRTerrainSnapshot *snapshot);
+VFRTerrain *vfr_terrain_snapshot_get(VFRTerrainSnapshot *snapshot, guint index);
+GPtrArray *vfr_terrain_snapshot_get_terrains(VFRTerrainSnapshot *snapshot);
+VFRTerrain *vfr_terrain_snapshot_lookup_icao(VFRTerrainSnapshot *snapshot, const gchar *icao);
+VFRTerrain *vfr_terrain_snapshot_lookup_name(VFRTerrainSnapshot *snapshot, const gchar *key);
+
+#endif /* _VFR_TERRAIN_SNAPSHOT_H */
@@ -7,26 +7,73 @@
 #include "terrain.h"
 
 struct _VFRTerrain {
-    GString *name;
-    GString *icao;
+    const gchar *name;
+    const gchar *icao;
     gboolean favorite;
+
+    // Part of a terrain array, strings are owned by someone else
+    gboolean is_static;
 };
 
 VFRTerrain *vfr_terrain_new(const gchar *name, const gchar *icao, gboolean favorite)
 {
     VFRTerrain *terrain = g_malloc0(sizeof(VFRTerrain));
 
-    terrain->name = g_string_new(name);
-    terrain->icao = g_string_new(icao);
+    terrain->name = g_strdup(name);
+    terrain->icao = g_strdup(icao);
     terrain->favorite = favorite;
 
     return terrain;
 }
 
+void vfr_terrain_free(VFRTerrain *terrain)
+{
+    if (!terrain || terrain->is_static)
+        return;
+
+    g_free((gchar *)terrain->name);
+    g_free((gchar *)terrain->icao);
+    g_free(terrain);
+}
+
+/*
+ * Terrain arrays allow loading a whole catalogue with a single allocation:
+ * their strings are only referenced, and must outlive the array.
+ */
+VFRTerrain *vfr_terrain_array_new(guint count)
+{
+    return g_new0(VFRTerrain, count);
+}
+
+VFRTerrain *vfr_terrain_array_get(VFRTerrain *array, guint index)
+{
+    if (array)
+        return &array[index];
+
+    return NULL;
+}
+
+void vfr_terrain_array_free(VFRTerrain *array)
+{
+    g_free(array);
+}
+
+void vfr_terrain_init_static(VFRTerrain *terrain, const gchar *name, const gchar *icao,
+                             gboolean favorite)
+{
+    if (!terrain)
+        return;
+
+    terrain->name = name;
+    terrain->icao = icao;
+    terrain->favorite = favorite;
+    terrain->is_static = TRUE;
+}
+
 const gchar *vfr_terrain_get_name(VFRTerrain *terrain)
 {
     if (terrain)
-        return terrain->name->str;
+        return terrain->name;
 
     return NULL;
 }
@@ -34,7 +81,7 @@ const gchar *vfr_terrain_get_name(VFRTerrain *terrain)
 const gchar *vfr_terrain_get_icao(VFRTerrain *terrain)
 {
     if (terrain)
-        return terrain->icao->str;
+        return terrain->icao;
 
     return NULL;
 }
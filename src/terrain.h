@@ -12,6 +12,13 @@
 typedef struct _VFRTerrain VFRTerrain;
 
 VFRTerrain *vfr_terrain_new(const gchar *name, const gchar *icao, gboolean favorite);
+void vfr_terrain_free(VFRTerrain *terrain);
+
+VFRTerrain *vfr_terrain_array_new(guint count);
+VFRTerrain *vfr_terrain_array_get(VFRTerrain *array, guint index);
+void vfr_terrain_array_free(VFRTerrain *array);
+void vfr_terrain_init_static(VFRTerrain *terrain, const gchar *name, const gchar *icao,
+                             gboolean favorite);
 
 const gchar *vfr_terrain_get_name(VFRTerrain *terrain);
 const gchar *vfr_terrain_get_icao(VFRTerrain *terrain);
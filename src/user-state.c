@@ -0,0 +1,463 @@
+/*
+ * (C) Copyright 2019, Arnaud Ferraris <arnaud.ferraris@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ */
+
+#include "user-state.h"
+
+#include "terrain.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <glib/gstdio.h>
+
+/*
+ * User state (favourites, time of last opening and notes) is kept per
+ * provider in $XDG_DATA_HOME/librevfr/<provider>/journal. Each change is
+ * appended as a single line, and synced to disk before returning (except
+ * openings, see user_journal_append()):
+ *   <checksum>\t<F|O|N>\t<ICAO>\t<value>
+ * F records whether the terrain is a favourite (0 or 1), O the time it was
+ * last opened and N its note (escaped). The checksum covers the rest of the
+ * line: a record torn by a crash is ignored, and the state is the one of
+ * the last complete change.
+ *
+ * Once the journal holds many more records than terrains with some state,
+ * it is compacted: the current state is written to a new file, which then
+ * atomically replaces the journal.
+ */
+
+typedef struct {
+    gboolean favorite;
+    gint64 last_open;
+    gchar *note;
+} VFRUserEntry;
+
+typedef struct {
+    GString *filename;
+    GHashTable *entries;
+    guint records;
+    int fd;
+
+    // The file ends with a torn record, which the next one must not extend
+    gboolean torn;
+} VFRUserJournal;
+
+static GMutex state_lock;
+static GHashTable *journals = NULL;
+
+static void user_entry_free(VFRUserEntry *entry)
+{
+    g_free(entry->note);
+    g_free(entry);
+}
+
+static guint32 user_state_checksum(const gchar *payload)
+{
+    return g_str_hash(payload);
+}
+
+static VFRUserEntry *user_journal_lookup(VFRUserJournal *journal, const gchar *icao,
+                                         gboolean create)
+{
+    VFRUserEntry *entry = g_hash_table_lookup(journal->entries, icao);
+
+    if (!entry && create) {
+        entry = g_malloc0(sizeof(VFRUserEntry));
+        g_hash_table_insert(journal->entries, g_strdup(icao), entry);
+    }
+
+    return entry;
+}
+
+static void user_journal_apply(VFRUserJournal *journal, gchar op, const gchar *icao,
+                               const gchar *value)
+{
+    VFRUserEntry *entry = user_journal_lookup(journal, icao, TRUE);
+
+    switch (op) {
+    case 'F':
+        entry->favorite = g_str_equal(value, "1");
+        break;
+    case 'O':
+        entry->last_open = g_ascii_strtoll(value, NULL, 10);
+        break;
+    case 'N':
+        g_free(entry->note);
+        entry->note = value[0] ? g_strcompress(value) : NULL;
+        break;
+    default:
+        break;
+    }
+}
+
+static void user_journal_parse(VFRUserJournal *journal, const gchar *line)
+{
+    gchar **fields = g_strsplit(line, "\t", 4);
+    const gchar *payload = strchr(line, '\t');
+
+    if (g_strv_length(fields) == 4 && payload && strlen(fields[1]) == 1 &&
+        g_ascii_strtoull(fields[0], NULL, 16) == user_state_checksum(payload + 1)) {
+        user_journal_apply(journal, fields[1][0], fields[2], fields[3]);
+        journal->records++;
+    }
+
+    g_strfreev(fields);
+}
+
+/*
+ * After a crash, the end of the file may hold an incomplete record, or
+ * even zero-filled blocks followed by records appended later on: records
+ * are delimited by newlines as well as NUL bytes, and only those ending
+ * with a newline (and a matching checksum) are kept.
+ */
+static void user_journal_load(VFRUserJournal *journal)
+{
+    gchar *contents = NULL;
+    gsize length = 0;
+    gsize start = 0;
+
+    if (!g_file_get_contents(journal->filename->str, &contents, &length, NULL))
+        return;
+
+    for (gsize i = 0; i < length; i++) {
+        if (contents[i] != '\n' && contents[i] != 0)
+            continue;
+
+        if (contents[i] == '\n' && i > start) {
+            gchar *line = g_strndup(contents + start, i - start);
+
+            user_journal_parse(journal, line);
+            g_free(line);
+        }
+        start = i + 1;
+    }
+
+    journal->torn = length > 0 && contents[length - 1] != '\n';
+
+    g_free(contents);
+}
+
+static gboolean user_journal_open(VFRUserJournal *journal)
+{
+    gchar *dir;
+
+    if (journal->fd >= 0)
+        return TRUE;
+
+    dir = g_path_get_dirname(journal->filename->str);
+    g_mkdir_with_parents(dir, 0755);
+    g_free(dir);
+
+    journal->fd = g_open(journal->filename->str, O_WRONLY | O_APPEND | O_CREAT, 0644);
+
+    return journal->fd >= 0;
+}
+
+// Must be called with the lock held
+static VFRUserJournal *user_journal_get(const gchar *provider)
+{
+    VFRUserJournal *journal;
+
+    if (!journals)
+        journals = g_hash_table_new(g_str_hash, g_str_equal);
+
+    journal = g_hash_table_lookup(journals, provider);
+    if (!journal) {
+        journal = g_malloc0(sizeof(VFRUserJournal));
+        journal->filename = g_string_new(g_get_user_data_dir());
+        g_string_append_printf(journal->filename, "/librevfr/%s/journal", provider);
+        journal->entries = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                                 (GDestroyNotify)user_entry_free);
+        journal->fd = -1;
+        user_journal_load(journal);
+
+        g_hash_table_insert(journals, g_strdup(provider), journal);
+    }
+
+    return journal;
+}
+
+static gboolean user_write_all(int fd, const gchar *data, gsize len)
+{
+    while (len > 0) {
+        gssize written = write(fd, data, len);
+
+        if (written < 0 && errno == EINTR)
+            continue;
+        if (written <= 0)
+            return FALSE;
+
+        data += written;
+        len -= written;
+    }
+
+    return TRUE;
+}
+
+static void user_format_record(GString *out, gchar op, const gchar *icao, const gchar *value)
+{
+    gchar *payload = g_strdup_printf("%c\t%s\t%s", op, icao, value);
+
+    g_string_append_printf(out, "%08x\t%s\n", user_state_checksum(payload), payload);
+    g_free(payload);
+}
+
+static void user_format_entry(GString *out, const gchar *icao, VFRUserEntry *entry)
+{
+    if (entry->favorite)
+        user_format_record(out, 'F', icao, "1");
+
+    if (entry->last_open > 0) {
+        gchar *value = g_strdup_printf("%" G_GINT64_FORMAT, entry->last_open);
+
+        user_format_record(out, 'O', icao, value);
+        g_free(value);
+    }
+
+    if (entry->note) {
+        gchar *value = g_strescape(entry->note, NULL);
+
+        user_format_record(out, 'N', icao, value);
+        g_free(value);
+    }
+}
+
+/*
+ * Write the current state to a new file, synced before it replaces the
+ * journal, so that either the old or the new journal is found after a crash.
+ * Must be called with the lock held.
+ */
+static gboolean user_journal_compact(VFRUserJournal *journal)
+{
+    GString *tmp = g_string_new(journal->filename->str);
+    GString *contents = g_string_new(NULL);
+    GHashTableIter iter;
+    gpointer key, value;
+    gboolean result = FALSE;
+    gchar *dir;
+    int fd;
+
+    g_hash_table_iter_init(&iter, journal->entries);
+    while (g_hash_table_iter_next(&iter, &key, &value))
+        user_format_entry(contents, key, value);
+
+    g_string_append(tmp, ".tmp");
+    fd = g_open(tmp->str, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd >= 0) {
+        result = user_write_all(fd, contents->str, contents->len) && fsync(fd) == 0;
+        close(fd);
+    }
+
+    if (result && g_rename(tmp->str, journal->filename->str) == 0) {
+        // Make the rename itself durable
+        dir = g_path_get_dirname(journal->filename->str);
+        fd = g_open(dir, O_RDONLY, 0);
+        if (fd >= 0) {
+            fsync(fd);
+            close(fd);
+        }
+        g_free(dir);
+
+        if (journal->fd >= 0)
+            close(journal->fd);
+        journal->fd = -1;
+        journal->torn = FALSE;
+        journal->records = 0;
+        for (const gchar *p = contents->str; *p; p++) {
+            if (*p == '\n')
+                journal->records++;
+        }
+    } else {
+        g_remove(tmp->str);
+        result = FALSE;
+    }
+
+    g_string_free(contents, TRUE);
+    g_string_free(tmp, TRUE);
+
+    return result;
+}
+
+/*
+ * Append a single change, must be called with the lock held. Openings are
+ * recorded each time a chart is shown, from the main thread: losing the
+ * last one is harmless, so they aren't synced (the next synced record or
+ * compaction will take them along).
+ */
+static gboolean user_journal_append(VFRUserJournal *journal, gchar op, const gchar *icao,
+                                    const gchar *value)
+{
+    GString *record = g_string_new(NULL);
+    gboolean result;
+
+    if (journal->torn)
+        g_string_append_c(record, '\n');
+    user_format_record(record, op, icao, value);
+
+    result = user_journal_open(journal) &&
+             user_write_all(journal->fd, record->str, record->len) &&
+             (op == 'O' || fsync(journal->fd) == 0);
+    g_string_free(record, TRUE);
+
+    if (!result)
+        return FALSE;
+
+    journal->torn = FALSE;
+    user_journal_apply(journal, op, icao, value);
+    journal->records++;
+
+    if (journal->records > VFR_USER_STATE_COMPACT_MIN &&
+        journal->records > VFR_USER_STATE_COMPACT_RATIO * g_hash_table_size(journal->entries)) {
+        user_journal_compact(journal);
+    }
+
+    return TRUE;
+}
+
+gboolean vfr_user_state_is_favorite(const gchar *provider, const gchar *icao)
+{
+    VFRUserEntry *entry;
+    gboolean result = FALSE;
+
+    if (!provider || !icao)
+        return FALSE;
+
+    g_mutex_lock(&state_lock);
+    entry = user_journal_lookup(user_journal_get(provider), icao, FALSE);
+    if (entry)
+        result = entry->favorite;
+    g_mutex_unlock(&state_lock);
+
+    return result;
+}
+
+gboolean vfr_user_state_set_favorite(const gchar *provider, const gchar *icao, gboolean favorite)
+{
+    gboolean result;
+
+    if (!provider || !icao)
+        return FALSE;
+
+    g_mutex_lock(&state_lock);
+    result = user_journal_append(user_journal_get(provider), 'F', icao, favorite ? "1" : "0");
+    g_mutex_unlock(&state_lock);
+
+    return result;
+}
+
+// Time of the last opening, 0 if the terrain's chart was never opened
+gint64 vfr_user_state_get_last_open(const gchar *provider, const gchar *icao)
+{
+    VFRUserEntry *entry;
+    gint64 result = 0;
+
+    if (!provider || !icao)
+        return 0;
+
+    g_mutex_lock(&state_lock);
+    entry = user_journal_lookup(user_journal_get(provider), icao, FALSE);
+    if (entry)
+        result = entry->last_open;
+    g_mutex_unlock(&state_lock);
+
+    return result;
+}
+
+gboolean vfr_user_state_touch(const gchar *provider, const gchar *icao)
+{
+    gchar *value;
+    gboolean result;
+
+    if (!provider || !icao)
+        return FALSE;
+
+    value = g_strdup_printf("%" G_GINT64_FORMAT, g_get_real_time() / G_USEC_PER_SEC);
+
+    g_mutex_lock(&state_lock);
+    result = user_journal_append(user_journal_get(provider), 'O', icao, value);
+    g_mutex_unlock(&state_lock);
+
+    g_free(value);
+
+    return result;
+}
+
+gchar *vfr_user_state_get_note(const gchar *provider, const gchar *icao)
+{
+    VFRUserEntry *entry;
+    gchar *result = NULL;
+
+    if (!provider || !icao)
+        return NULL;
+
+    g_mutex_lock(&state_lock);
+    entry = user_journal_lookup(user_journal_get(provider), icao, FALSE);
+    if (entry)
+        result = g_strdup(entry->note);
+    g_mutex_unlock(&state_lock);
+
+    return result;
+}
+
+// A NULL or empty note removes it
+gboolean vfr_user_state_set_note(const gchar *provider, const gchar *icao, const gchar *note)
+{
+    gchar *value;
+    gboolean result;
+
+    if (!provider || !icao)
+        return FALSE;
+
+    value = g_strescape(note ? note : "", NULL);
+
+    g_mutex_lock(&state_lock);
+    result = user_journal_append(user_journal_get(provider), 'N', icao, value);
+    g_mutex_unlock(&state_lock);
+
+    g_free(value);
+
+    return result;
+}
+
+/*
+ * Favourites used to be stored in the terrains list: keep them when the
+ * journal is created.
+ */
+void vfr_user_state_import_favorites(const gchar *provider, GPtrArray *terrains)
+{
+    VFRUserJournal *journal;
+
+    if (!provider || !terrains)
+        return;
+
+    g_mutex_lock(&state_lock);
+    journal = user_journal_get(provider);
+    if (!g_file_test(journal->filename->str, G_FILE_TEST_EXISTS)) {
+        for (guint i = 0; i < terrains->len; i++) {
+            VFRTerrain *terrain = terrains->pdata[i];
+
+            if (vfr_terrain_is_favorite(terrain))
+                user_journal_append(journal, 'F', vfr_terrain_get_icao(terrain), "1");
+        }
+    }
+    g_mutex_unlock(&state_lock);
+}
+
+gboolean vfr_user_state_compact(const gchar *provider)
+{
+    gboolean result;
+
+    if (!provider)
+        return FALSE;
+
+    g_mutex_lock(&state_lock);
+    result = user_journal_compact(user_journal_get(provider));
+    g_mutex_unlock(&state_lock);
+
+    return result;
+}
@@ -0,0 +1,27 @@
+/*
+ * (C) Copyright 2019, Arnaud Ferraris <arnaud.ferraris@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0
+ */
+
+#ifndef _VFR_USER_STATE_H
+#define _VFR_USER_STATE_H
+
+#include <glib.h>
+
+#define VFR_USER_STATE_COMPACT_MIN 256
+#define VFR_USER_STATE_COMPACT_RATIO 4
+
+gboolean vfr_user_state_is_favorite(const gchar *provider, const gchar *icao);
+gboolean vfr_user_state_set_favorite(const gchar *provider, const gchar *icao, gboolean favorite);
+
+gint64 vfr_user_state_get_last_open(const gchar *provider, const gchar *icao);
+gboolean vfr_user_state_touch(const gchar *provider, const gchar *icao);
+
+gchar *vfr_user_state_get_note(const gchar *provider, const gchar *icao);
+gboolean vfr_user_state_set_note(const gchar *provider, const gchar *icao, const gchar *note);
+
+void vfr_user_state_import_favorites(const gchar *provider, GPtrArray *terrains);
+gboolean vfr_user_state_compact(const gchar *provider);
+
+#endif /* _VFR_USER_STATE_H */
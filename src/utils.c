@@ -6,46 +6,96 @@
 
 #include "utils.h"
 
+#include <string.h>
+
 #define DAY_IN_SECONDS (24*3600)
 #define AIRAC_IN_SECONDS (28*DAY_IN_SECONDS)
 #define AIRAC_ORIGIN (1420675200)
 
-GString *vfr_get_current_airac(void)
+/*
+ * AIRAC cycles last 28 days and start on fixed dates, counted from a known
+ * cycle start: cycles are relative to the one in effect right now.
+ */
+time_t vfr_get_airac_date(VFRAiracCycle cycle)
+{
+    time_t now = time(NULL);
+
+    return AIRAC_ORIGIN + ((now - AIRAC_ORIGIN) / AIRAC_IN_SECONDS + cycle) * AIRAC_IN_SECONDS;
+}
+
+GString *vfr_get_airac(VFRAiracCycle cycle)
 {
     GString *airac = g_string_new(NULL);
 
-    time_t now = time(NULL);
-    time_t diff = now - AIRAC_ORIGIN;
+    time_t date = vfr_get_airac_date(cycle);
     char *months[] = {
         "JAN", "FEB", "MAR", "APR", "MAY", "JUN",
         "JUL", "AUG", "SEP", "OCT", "NOV", "DEC"
     };
-    struct tm *airac_date;
+    struct tm airac_date;
 
-    now = AIRAC_ORIGIN + ((now - AIRAC_ORIGIN) / AIRAC_IN_SECONDS) * AIRAC_IN_SECONDS;
-    airac_date = gmtime(&now);
+    gmtime_r(&date, &airac_date);
 
-    g_string_printf(airac, "%02d_%s_%04d", airac_date->tm_mday,
-                                           months[airac_date->tm_mon],
-                                           airac_date->tm_year + 1900);
+    g_string_printf(airac, "%02d_%s_%04d", airac_date.tm_mday,
+                                           months[airac_date.tm_mon],
+                                           airac_date.tm_year + 1900);
 
     return airac;
 }
 
+GString *vfr_get_current_airac(void)
+{
+    return vfr_get_airac(VFR_AIRAC_CURRENT);
+}
+
 GString *vfr_get_current_date(void)
 {
     GString *date = g_string_new(NULL);
 
     time_t now = time(NULL);
-    struct tm *current_date = gmtime(&now);
+    struct tm current_date;
 
-    g_string_printf(date, "%02d-%02d-%04d", current_date->tm_mday,
-                                            current_date->tm_mon,
-                                            current_date->tm_year + 1900);
+    gmtime_r(&now, &current_date);
+
+    g_string_printf(date, "%02d-%02d-%04d", current_date.tm_mday,
+                                            current_date.tm_mon,
+                                            current_date.tm_year + 1900);
 
     return date;
 }
 
+/*
+ * Fold a string for case- and accent-insensitive comparisons: decompose
+ * it, drop the combining marks and casefold the remaining characters.
+ */
+gchar *vfr_normalize_string(const gchar *str)
+{
+    GString *result;
+    gchar *decomposed;
+    gchar *folded;
+
+    if (!str)
+        return NULL;
+
+    decomposed = g_utf8_normalize(str, -1, G_NORMALIZE_NFD);
+    if (!decomposed)
+        return g_strdup("");
+
+    result = g_string_sized_new(strlen(decomposed));
+    for (const gchar *p = decomposed; *p; p = g_utf8_next_char(p)) {
+        gunichar c = g_utf8_get_char(p);
+
+        if (!g_unichar_ismark(c))
+            g_string_append_unichar(result, c);
+    }
+    g_free(decomposed);
+
+    folded = g_utf8_casefold(result->str, result->len);
+    g_string_free(result, TRUE);
+
+    return folded;
+}
+
 void vfr_ui_empty_list_box(GtkWidget *list)
 {
     GtkListBoxRow *row;
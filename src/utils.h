@@ -9,9 +9,19 @@
 
 #include <gtk/gtk.h>
 
+typedef enum {
+    VFR_AIRAC_PREVIOUS = -1,
+    VFR_AIRAC_CURRENT = 0,
+    VFR_AIRAC_NEXT = 1,
+} VFRAiracCycle;
+
+time_t vfr_get_airac_date(VFRAiracCycle cycle);
+GString *vfr_get_airac(VFRAiracCycle cycle);
 GString *vfr_get_current_airac(void);
 GString *vfr_get_current_date(void);
 
+gchar *vfr_normalize_string(const gchar *str);
+
 void vfr_ui_empty_list_box(GtkWidget *list);
 GtkWidget *vfr_ui_widget_get_descendent(GtkWidget *parent, GType type);
 
@@ -0,0 +1,285 @@
+#!/usr/bin/env python3
+#
+# (C) Copyright 2019, Arnaud Ferraris <arnaud.ferraris@gmail.com>
+#
+# SPDX-License-Identifier: GPL-3.0
+#
+# Benchmark chart synchronisation against a local stand-in for the SIA
+# server, which serves a synthetic terrains list and charts with some added
+# latency per request (like a distant server would):
+#
+#   tools/sync-bench.py [--charts N] [--latency MS] [--transfers N]
+#
+# librevfr --sync is run twice on empty data directories, with a single
+# transfer then with several, and both results are compared. With --serve,
+# the stand-in is only started, e.g. to run `librevfr --sync` manually.
+#
+# Failures can be injected to check how synchronisation copes with them:
+# --fail-rate (503 errors), --throttle-rate (429 errors) and --reset-rate
+# (connections closed halfway through a chart) give the probability of each
+# fault, the charts must still all be received thanks to retries. With
+# --outage, the server answers every request with an error for the given
+# number of seconds: the sync should then give up quickly rather than wait
+# for each chart to time out.
+
+import argparse
+import hashlib
+import os
+import random
+import shutil
+import socket
+import subprocess
+import sys
+import tempfile
+import threading
+import time
+
+from email.utils import formatdate
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+# Same computation as vfr_get_airac_date()
+AIRAC_ORIGIN = 1420675200
+AIRAC_PERIOD = 28 * 24 * 3600
+MONTHS = ['JAN', 'FEB', 'MAR', 'APR', 'MAY', 'JUN',
+          'JUL', 'AUG', 'SEP', 'OCT', 'NOV', 'DEC']
+
+LAST_MODIFIED = formatdate(AIRAC_ORIGIN, usegmt=True)
+
+
+def current_airac():
+    now = int(time.time())
+    date = AIRAC_ORIGIN + (now - AIRAC_ORIGIN) // AIRAC_PERIOD * AIRAC_PERIOD
+    tm = time.gmtime(date)
+    return '%02d_%s_%04d' % (tm.tm_mday, MONTHS[tm.tm_mon - 1], tm.tm_year)
+
+
+class StandIn:
+    def __init__(self, charts, chart_size, latency, faults={}, outage=0):
+        self.latency = latency / 1000.0
+        self.faults = faults
+        self.outage_end = time.monotonic() + outage
+        self.injected = {}
+        self.airac = current_airac()
+        self.codes = ['LF%04d' % i for i in range(charts)]
+        self.chart_size = chart_size
+        self.charts = {}
+        self.lock = threading.Lock()
+        self.requests = 0
+
+        names = ['TERRAIN %d DE L\'ESSAI' % i for i in range(charts)]
+        self.list = ('var TabIcao = new Array(%s);\nvar TabNom = new Array(%s);\n' % (
+            ','.join('"%s"' % c for c in self.codes),
+            ','.join('"%s"' % n for n in names))).encode()
+
+    def chart(self, code):
+        # Identical on every request, so that reruns find charts unchanged
+        with self.lock:
+            if code not in self.charts:
+                rand = random.Random(code)
+                body = rand.getrandbits(8 * self.chart_size).to_bytes(self.chart_size, 'little')
+                self.charts[code] = b'%PDF-1.4\n' + body + b'\n%%EOF\n'
+            return self.charts[code]
+
+    def inject(self):
+        with self.lock:
+            fault = None
+            if time.monotonic() < self.outage_end:
+                fault = 'outage'
+            else:
+                draw = random.random()
+                for kind, rate in self.faults.items():
+                    if draw < rate:
+                        fault = kind
+                        break
+                    draw -= rate
+            if fault:
+                self.injected[fault] = self.injected.get(fault, 0) + 1
+            return fault
+
+    def expected(self):
+        return {'%s.pdf' % code: hashlib.sha256(self.chart(code)).hexdigest()
+                for code in self.codes}
+
+    def lookup(self, path):
+        prefix = '/dvd/eAIP_%s/Atlas-VAC/' % self.airac
+        if not path.startswith(prefix):
+            return None
+        path = path[len(prefix):]
+        if path == 'Javascript/AeroArraysVac.js':
+            return self.list
+        if path.startswith('PDF_AIPparSSection/VAC/AD/AD-2.') and path.endswith('.pdf'):
+            code = path[len('PDF_AIPparSSection/VAC/AD/AD-2.'):-len('.pdf')]
+            if code in self.codes:
+                return self.chart(code)
+        return None
+
+
+class Handler(BaseHTTPRequestHandler):
+    # Keep connections open, as the real server does
+    protocol_version = 'HTTP/1.1'
+
+    def log_message(self, format, *args):
+        pass
+
+    def send_body(self, status, body, headers={}, head=False):
+        self.send_response(status)
+        for key, value in headers.items():
+            self.send_header(key, value)
+        self.send_header('Content-Length', str(len(body)))
+        self.end_headers()
+        if not head:
+            self.wfile.write(body)
+
+    def respond(self, head):
+        standin = self.server.standin
+        with standin.lock:
+            standin.requests += 1
+        time.sleep(standin.latency)
+
+        fault = standin.inject()
+        if fault in ('fail', 'outage'):
+            self.send_body(503, b'Service unavailable\n', head=head)
+            return
+        elif fault == 'throttle':
+            self.send_body(429, b'Too many requests\n', {'Retry-After': '1'}, head)
+            return
+
+        body = standin.lookup(self.path)
+        if body is None:
+            self.send_body(404, b'Not found\n', head=head)
+            return
+
+        # Promise the whole chart, but only send half of it
+        if fault == 'reset' and not head:
+            self.send_response(200)
+            self.send_header('Content-Length', str(len(body)))
+            self.end_headers()
+            self.wfile.write(body[:len(body) // 2])
+            self.wfile.flush()
+            self.connection.shutdown(socket.SHUT_RDWR)
+            self.close_connection = True
+            return
+
+        etag = '"%s"' % hashlib.sha256(body).hexdigest()[:16]
+        headers = {'ETag': etag, 'Last-Modified': LAST_MODIFIED}
+        if self.headers.get('If-None-Match') == etag:
+            self.send_body(304, b'', headers, head=True)
+            return
+
+        # Resumed downloads, only if the partial file is still valid
+        ranges = self.headers.get('Range', '')
+        if_range = self.headers.get('If-Range')
+        if ranges.startswith('bytes=') and ranges.endswith('-') and \
+           if_range in (None, etag, LAST_MODIFIED):
+            start = int(ranges[len('bytes='):-1])
+            if start < len(body):
+                headers['Content-Range'] = 'bytes %d-%d/%d' % (start, len(body) - 1, len(body))
+                self.send_body(206, body[start:], headers, head)
+                return
+
+        self.send_body(200, body, headers, head)
+
+    def do_GET(self):
+        self.respond(False)
+
+    def do_HEAD(self):
+        self.respond(True)
+
+
+def start_server(standin, port):
+    server = ThreadingHTTPServer(('127.0.0.1', port), Handler)
+    server.daemon_threads = True
+    server.standin = standin
+    threading.Thread(target=server.serve_forever, daemon=True).start()
+    return server
+
+
+def list_files(root):
+    files = {}
+    for dirpath, _, filenames in os.walk(root):
+        for name in filenames:
+            if name.endswith('.pdf'):
+                with open(os.path.join(dirpath, name), 'rb') as f:
+                    files[name] = hashlib.sha256(f.read()).hexdigest()
+    return files
+
+
+def run_sync(args, url, transfers):
+    data_dir = tempfile.mkdtemp(prefix='librevfr-bench-')
+    env = dict(os.environ, XDG_DATA_HOME=data_dir)
+    command = [args.binary, '--sync', '--force', '--no-previews',
+               '--transfers=%d' % transfers, '--base-url=sia=' + url, 'sia']
+
+    start = time.monotonic()
+    result = subprocess.run(command, env=env, stdout=subprocess.PIPE,
+                            stderr=subprocess.STDOUT, universal_newlines=True)
+    elapsed = time.monotonic() - start
+
+    files = list_files(os.path.join(data_dir, 'librevfr', 'sia'))
+    shutil.rmtree(data_dir, ignore_errors=True)
+
+    print('--transfers=%d: %.2fs, %d charts' % (transfers, elapsed, len(files)))
+    for line in result.stdout.splitlines():
+        print('  ' + line)
+
+    return result.returncode, elapsed, files
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Benchmark chart synchronisation')
+    parser.add_argument('--binary', default=os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                                                         '..', 'librevfr'))
+    parser.add_argument('--port', type=int, default=0)
+    parser.add_argument('--charts', type=int, default=300)
+    parser.add_argument('--chart-size', type=int, default=64 * 1024, help='bytes')
+    parser.add_argument('--latency', type=float, default=50, help='milliseconds')
+    parser.add_argument('--transfers', type=int, default=8)
+    parser.add_argument('--fail-rate', type=float, default=0)
+    parser.add_argument('--throttle-rate', type=float, default=0)
+    parser.add_argument('--reset-rate', type=float, default=0)
+    parser.add_argument('--outage', type=float, default=0, help='seconds')
+    parser.add_argument('--serve', action='store_true', help='only run the stand-in')
+    args = parser.parse_args()
+
+    faults = {'fail': args.fail_rate, 'throttle': args.throttle_rate,
+              'reset': args.reset_rate}
+    standin = StandIn(args.charts, args.chart_size, args.latency, faults, args.outage)
+    server = start_server(standin, args.port)
+    url = 'http://127.0.0.1:%d' % server.server_address[1]
+
+    if args.serve:
+        print('Serving AIRAC cycle %s on %s (--base-url=sia=%s)' % (standin.airac, url, url))
+        try:
+            threading.Event().wait()
+        except KeyboardInterrupt:
+            return 0
+
+    # Charts can't be received during an outage, only check it ends quickly
+    if args.outage > 0:
+        status, elapsed, files = run_sync(args, url, args.transfers)
+        print('Outage of %.0fs: sync ended after %.2fs, %d requests served, %d charts' % (
+            args.outage, elapsed, standin.requests, len(files)))
+        return status
+
+    expected = standin.expected()
+    status, serial, reference = run_sync(args, url, 1)
+    if status != 0:
+        return status
+    status, parallel, files = run_sync(args, url, args.transfers)
+    if status != 0:
+        return status
+
+    if standin.injected:
+        print('Injected faults: ' + ', '.join('%d %s' % (count, kind)
+                                              for kind, count in standin.injected.items()))
+
+    if reference != expected or files != expected:
+        print('Charts missing or differing from the ones served')
+        return 1
+
+    print('Speedup with %d transfers: %.1fx (%d requests served)' % (
+        args.transfers, serial / parallel, standin.requests))
+    return 0
+
+if __name__ == '__main__':
+    sys.exit(main())